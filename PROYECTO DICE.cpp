@@ -3,7 +3,10 @@
  * -------------------------------------------
  * Features:
  * - Add, delete, and list transactions
- * - Save and load transactions from a CSV file
+ * - Save and load transactions from a CSV file or a binary snapshot
+ * - Changes are journaled next to the ledger (<file>.journal) and replayed
+ *   when it is opened; saves go through <file>.tmp and replace it atomically
+ * - Startup reopens data.csv or data.pfm, whichever was used last
  * - Search and sort transactions
  * - Monthly income/expense summary
  * - Budget categories with alerts
@@ -16,39 +19,133 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <array>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <unordered_map>
+#include <deque>
 #include <limits>
+#include <new>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <charconv>
+#include <system_error>
+#include <string_view>
+#include <thread>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
  // --------------------------------------------------------------------
  // ---------------------------- UTILITIES ------------------------------
  // --------------------------------------------------------------------
 
- // Removes whitespace from the beginning and end of a string.
-std::string trim(const std::string& str) {
+ // Returns a view of the string without whitespace at the beginning and end.
+std::string_view trimView(std::string_view str) {
     size_t start = str.find_first_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
+    if (start == std::string_view::npos) return std::string_view();
     size_t end = str.find_last_not_of(" \t\n\r");
     return str.substr(start, end - start + 1);
 }
 
-// Checks if a string represents a valid number (integer or floating point).
-bool isNumber(const std::string& s) {
-    std::istringstream iss(s);
+// Removes whitespace from the beginning and end of a string.
+std::string trim(const std::string& str) {
+    return std::string(trimView(str));
+}
+
+// Parses a number (integer or floating point) in a single pass, without
+// building a stream. Accepts the same text as "stream >> double" with nothing
+// left over: surrounding whitespace, an optional sign, digits with an optional
+// fraction and exponent. Values that do not fit a normal double are rejected.
+bool parseAmount(std::string_view s, double& value) {
+    const char* spaces = " \t\n\v\f\r";
+    size_t start = s.find_first_not_of(spaces);
+    if (start == std::string_view::npos) return false;
+    s = s.substr(start, s.find_last_not_of(spaces) - start + 1);
+
+    // from_chars rejects '+' but accepts "inf", "nan", etc., so the sign and
+    // first character are checked by hand.
+    size_t first = (s[0] == '+' || s[0] == '-') ? 1 : 0;
+    if (first >= s.size()) return false;
+    if (!isdigit(static_cast<unsigned char>(s[first])) && s[first] != '.') return false;
+    if (s[0] == '+') s.remove_prefix(1);
+
     double d;
-    char c;
+    const char* end = s.data() + s.size();
+    std::from_chars_result r = std::from_chars(s.data(), end, d);
+    if (r.ec != std::errc() || r.ptr != end) return false;
+    if (d != 0 && std::fabs(d) < std::numeric_limits<double>::min()) return false;
+
+    value = d;
+    return true;
+}
 
-    // First check: can we read a number?
-    if (!(iss >> d)) return false;
+// Money is kept as a whole number of minor units (cents by default), so sums
+// are exact and give the same result in any order.
+typedef std::int64_t Money;
 
-    // Second check: ensure no extra characters remain.
-    if (iss >> c) return false;
+// Number of decimal digits in the minor unit (2 for cents).
+constexpr int MONEY_DECIMALS = 2;
 
+constexpr Money moneyScale(int decimals) {
+    return decimals == 0 ? 1 : 10 * moneyScale(decimals - 1);
+}
+
+constexpr Money MONEY_SCALE = moneyScale(MONEY_DECIMALS);
+
+// Parses an amount (see parseAmount) and rounds it to the nearest minor unit.
+bool parseMoney(std::string_view s, Money& value) {
+    double d;
+    if (!parseAmount(s, d)) return false;
+
+    double scaled = std::round(d * MONEY_SCALE);
+    if (std::fabs(scaled) >= 9.2e18) return false; // Does not fit in 64 bits.
+
+    value = static_cast<Money>(scaled);
     return true;
 }
 
-// Validates the date format "YYYY-MM-DD".
-bool validateDate(const std::string& date) {
+// Writes 'value' as a decimal number ("-12.50") into 'out' and returns the
+// end of the written text. 'out' needs room for 21 + MONEY_DECIMALS chars.
+char* writeMoney(Money value, char* out) {
+    std::uint64_t magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : value;
+    if (value < 0) *out++ = '-';
+
+    out = std::to_chars(out, out + 20, magnitude / MONEY_SCALE).ptr;
+    if (MONEY_DECIMALS > 0) {
+        *out++ = '.';
+        std::uint64_t fraction = magnitude % MONEY_SCALE;
+        for (int i = MONEY_DECIMALS - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        out += MONEY_DECIMALS;
+    }
+    return out;
+}
+
+// Formats an amount of money as a decimal string ("-12.50").
+std::string formatMoney(Money value) {
+    char buf[24 + MONEY_DECIMALS];
+    return std::string(buf, writeMoney(value, buf));
+}
+
+// Validates the date format "YYYY-MM-DD" and packs it as the integer
+// YYYYMMDD, so that dates compare and sort as plain integers.
+bool validateDate(std::string_view date, std::uint32_t& packed) {
     // Basic format validation.
     if (date.size() != 10) return false;
     if (date[4] != '-' || date[7] != '-') return false;
@@ -60,22 +157,40 @@ bool validateDate(const std::string& date) {
     }
 
     // Basic range validation (not a full calendar validation).
-    try {
-        int year = stoi(date.substr(0, 4));
-        int month = stoi(date.substr(5, 2));
-        int day = stoi(date.substr(8, 2));
+    int year = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+    int month = (date[5] - '0') * 10 + (date[6] - '0');
+    int day = (date[8] - '0') * 10 + (date[9] - '0');
 
-        if (month < 1 || month > 12) return false;
-        if (day < 1 || day > 31) return false;
-        if (year < 1900 || year > 2100) return false;
-    }
-    catch (...) {
-        return false;
-    }
+    if (month < 1 || month > 12) return false;
+    if (day < 1 || day > 31) return false;
+    if (year < 1900 || year > 2100) return false;
 
+    packed = static_cast<std::uint32_t>(year * 10000 + month * 100 + day);
     return true;
 }
 
+// Writes a packed YYYYMMDD date as "YYYY-MM-DD" (10 characters) into 'out'.
+char* writeDate(std::uint32_t packed, char* out) {
+    const char digits[8] = {
+        char('0' + packed / 10000000 % 10), char('0' + packed / 1000000 % 10),
+        char('0' + packed / 100000 % 10), char('0' + packed / 10000 % 10),
+        char('0' + packed / 1000 % 10), char('0' + packed / 100 % 10),
+        char('0' + packed / 10 % 10), char('0' + packed % 10) };
+    std::memcpy(out, digits, 4);
+    out[4] = '-';
+    std::memcpy(out + 5, digits + 4, 2);
+    out[7] = '-';
+    std::memcpy(out + 8, digits + 6, 2);
+    return out + 10;
+}
+
+// Formats a packed YYYYMMDD date as "YYYY-MM-DD".
+std::string formatDate(std::uint32_t packed) {
+    char buf[10];
+    writeDate(packed, buf);
+    return std::string(buf, sizeof(buf));
+}
+
 // Reads an integer with full validation and range control.
 int readInt(const std::string& prompt, int min, int max) {
     int value;
@@ -98,26 +213,543 @@ int readInt(const std::string& prompt, int min, int max) {
     }
 }
 
-// Reads a double value with validation.
-double readDouble(const std::string& prompt) {
-    double value;
+// Reads a transaction id (a positive whole number).
+std::uint64_t readId(const std::string& prompt) {
     while (true) {
         std::cout << prompt;
         std::string line;
         std::getline(std::cin, line);
 
-        try {
-            value = std::stod(line);
+        std::string_view text = trimView(line);
+        std::uint64_t value = 0;
+        std::from_chars_result r = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (!text.empty() && r.ec == std::errc() && r.ptr == text.data() + text.size() && value > 0)
+            return value;
+
+        std::cout << "Invalid input. Try again.\n";
+    }
+}
+
+// Reads a yes/no answer; anything but "y" or "yes" counts as no.
+bool readYes(const std::string& prompt) {
+    std::cout << prompt;
+    std::string line;
+    std::getline(std::cin, line);
+
+    std::string answer(trimView(line));
+    for (char& c : answer) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return answer == "y" || answer == "yes";
+}
+
+// Reads an amount of money with validation.
+Money readMoney(const std::string& prompt) {
+    Money value;
+    while (true) {
+        std::cout << prompt;
+        std::string line;
+        std::getline(std::cin, line);
+
+        if (parseMoney(line, value))
             return value;
+
+        std::cout << "Invalid input. Try again.\n";
+    }
+}
+
+// Read-only memory mapping of a whole file. The contents stay valid
+// until the object is destroyed.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+    bool ok;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+
+public:
+    explicit MappedFile(const std::string& filename) : bytes(nullptr), length(0), ok(false) {
+#ifdef _WIN32
+        mappingHandle = NULL;
+        fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) return;
+        length = static_cast<size_t>(fileSize.QuadPart);
+        ok = true;
+        if (length == 0) return; // Empty files cannot be mapped.
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle != NULL)
+            bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (bytes == nullptr) { ok = false; length = 0; }
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            length = static_cast<size_t>(st.st_size);
+            ok = true;
+
+            if (length > 0) { // Empty files cannot be mapped.
+                void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) { ok = false; length = 0; }
+                else {
+                    bytes = static_cast<const char*>(p);
+                    madvise(p, length, MADV_SEQUENTIAL);
+                }
+            }
         }
-        catch (...) {
-            std::cout << "Invalid input. Try again.\n";
+        close(fd); // The mapping keeps its own reference to the file.
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mappingHandle != NULL) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return ok; }
+    std::string_view contents() const { return std::string_view(bytes, length); }
+};
+
+// Fast non-cryptographic 64-bit hash of a stream of bytes (8 bytes per
+// step). The bytes may arrive in pieces of any size; the result only
+// depends on their concatenation.
+class ByteHasher {
+private:
+    static constexpr std::uint64_t prime = 0x100000001b3ULL;
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    std::uint64_t total = 0;
+    unsigned char partial[8];   // Bytes of a word not yet complete
+    size_t partialBytes = 0;
+
+    void mixWord(const void* bytes) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+
+public:
+    void update(std::string_view data) {
+        total += data.size();
+        if (partialBytes > 0) {
+            size_t n = std::min(data.size(), 8 - partialBytes);
+            std::memcpy(partial + partialBytes, data.data(), n);
+            partialBytes += n;
+            data.remove_prefix(n);
+            if (partialBytes < 8) return;
+            mixWord(partial);
+            partialBytes = 0;
+        }
+
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8) mixWord(data.data() + i);
+        partialBytes = data.size() - i;
+        std::memcpy(partial, data.data() + i, partialBytes);
+    }
+
+    // Number of bytes hashed so far.
+    std::uint64_t size() const { return total; }
+
+    std::uint64_t value() const {
+        std::uint64_t v = h;
+        for (size_t i = 0; i < partialBytes; ++i) v = (v ^ partial[i]) * prime;
+        return (v ^ total) * prime;
+    }
+};
+
+// Collects output in a large reusable buffer and passes it to the file in
+// big fwrite() calls instead of formatting field by field.
+class BufferedWriter {
+private:
+    std::FILE* out;
+    std::vector<char> buffer;
+    size_t used;
+    ByteHasher* hasher = nullptr;
+
+public:
+    explicit BufferedWriter(std::FILE* file, size_t capacity = 1 << 20)
+        : out(file), buffer(capacity), used(0) {}
+
+    ~BufferedWriter() { flush(); }
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    // Returns space for at least 'n' bytes (n must not exceed the capacity);
+    // call commit() with the end of what was written.
+    char* reserve(size_t n) {
+        if (buffer.size() - used < n) flush();
+        return buffer.data() + used;
+    }
+
+    void commit(char* end) { used = end - buffer.data(); }
+
+    void put(char c) { *reserve(1) = c; ++used; }
+
+    // Appends 'text', replacing every 'from' with 'to' while copying.
+    void append(std::string_view text, char from = '\0', char to = '\0') {
+        while (!text.empty()) {
+            if (used == buffer.size()) flush();
+            size_t n = std::min(text.size(), buffer.size() - used);
+            char* dest = buffer.data() + used;
+            std::memcpy(dest, text.data(), n);
+            if (from != to) std::replace(dest, dest + n, from, to);
+            used += n;
+            text.remove_prefix(n);
+        }
+    }
+
+    // Appends 'text' right-aligned in a field of 'width' characters (like
+    // std::setw); longer text is not cut.
+    void appendPadded(std::string_view text, size_t width) {
+        for (size_t i = text.size(); i < width; ++i) put(' ');
+        append(text);
+    }
+
+    // Also feeds every byte written from now on to 'h'.
+    void hashInto(ByteHasher& h) { hasher = &h; }
+
+    void flush() {
+        if (used > 0) {
+            std::fwrite(buffer.data(), 1, used, out);
+            if (hasher) hasher->update(std::string_view(buffer.data(), used));
+        }
+        used = 0;
+    }
+};
+
+// Writes a file under a temporary name in the same directory and only renames
+// it over the target once its contents are on disk. A crash during the save
+// leaves either the old file or the new one, never a truncated mix.
+class AtomicFile {
+private:
+    std::string target;
+    std::string tempName;
+    std::FILE* fp;
+
+public:
+    explicit AtomicFile(const std::string& filename)
+        : target(filename), tempName(filename + ".tmp") {
+        fp = std::fopen(tempName.c_str(), "wb");
+        if (fp) std::setvbuf(fp, nullptr, _IONBF, 0); // Callers buffer themselves.
+    }
+
+    // Drops the temporary file if commit() was never reached.
+    ~AtomicFile() {
+        if (fp) {
+            std::fclose(fp);
+            std::remove(tempName.c_str());
+        }
+    }
+
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+
+    // Outcome of commit(). DIRECTORY_NOT_SYNCED means the target was already
+    // replaced, only the directory sync that makes the rename durable failed.
+    enum Result { FAILED, DONE, DIRECTORY_NOT_SYNCED };
+
+    bool isOpen() const { return fp != nullptr; }
+    std::FILE* handle() { return fp; }
+
+    // Flushes and syncs the temporary file, then renames it over the target.
+    // With 'syncDirectory' the directory entry is synced as well, so the
+    // rename itself survives a power loss (no-op on Windows).
+    Result commit(bool syncDirectory) {
+        bool ok = std::fflush(fp) == 0 && !std::ferror(fp);
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(fp)) == 0;
+#else
+        ok = ok && fsync(fileno(fp)) == 0;
+#endif
+        ok = (std::fclose(fp) == 0) && ok;
+        fp = nullptr;
+
+        if (!ok) {
+            std::remove(tempName.c_str());
+            return FAILED;
+        }
+
+#ifdef _WIN32
+        (void)syncDirectory;
+        if (!MoveFileExA(tempName.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            std::remove(tempName.c_str());
+            return FAILED;
+        }
+        return DONE;
+#else
+        if (std::rename(tempName.c_str(), target.c_str()) != 0) {
+            std::remove(tempName.c_str());
+            return FAILED;
+        }
+
+        if (syncDirectory) {
+            size_t slash = target.find_last_of('/');
+            std::string dir = slash == std::string::npos ? "." : target.substr(0, slash + 1);
+            int dirFd = open(dir.c_str(), O_RDONLY);
+            if (dirFd < 0) return DIRECTORY_NOT_SYNCED;
+            ok = fsync(dirFd) == 0;
+            close(dirFd);
+            if (!ok) return DIRECTORY_NOT_SYNCED;
+        }
+        return DONE;
+#endif
+    }
+};
+
+// Identifies the contents of a ledger file ("#snapshot <size> <hash>"),
+// from the bytes as they were written.
+std::string snapshotStamp(const ByteHasher& written) {
+    return "#snapshot " + std::to_string(written.size()) + " " + std::to_string(written.value());
+}
+
+// The same for contents already in memory (a missing file is empty).
+std::string snapshotStamp(std::string_view contents) {
+    ByteHasher h;
+    h.update(contents);
+    return snapshotStamp(h);
+}
+
+// Finds when the ledger 'filename' last changed: the later of its own
+// modification time and its journal's. Returns false if neither exists.
+bool lastChanged(const std::string& filename, std::filesystem::file_time_type& when) {
+    bool found = false;
+    for (const std::string& path : { filename, filename + ".journal" }) {
+        std::error_code ec;
+        std::filesystem::file_time_type t = std::filesystem::last_write_time(path, ec);
+        if (ec) continue;
+        if (!found || t > when) when = t;
+        found = true;
+    }
+    return found;
+}
+
+// Append-only log of the changes made since a ledger file was last loaded or
+// saved. It lives next to the ledger ("<file>.journal"), and its first line
+// is the stamp of the snapshot it applies to, so a journal left over from an
+// older save is recognised and ignored.
+class Journal {
+private:
+    std::string stamp; // Of the snapshot the records extend
+    std::string path;
+    std::FILE* fp = nullptr;
+    bool needsNewline = false; // The last record on disk was cut short
+
+public:
+    ~Journal() { close(); }
+
+    const std::string& getPath() const { return path; }
+
+    // Makes 'filename' the snapshot that new records extend. 'snapshot' is
+    // its stamp, worked out by whoever last read or wrote the whole file,
+    // so that appending never has to read the ledger again.
+    void attach(const std::string& filename, const std::string& snapshot) {
+        close();
+        stamp = snapshot;
+        path = filename + ".journal";
+        needsNewline = false;
+    }
+
+    // Called by replay when the file ends in the middle of a record.
+    void markTornTail() { needsNewline = true; }
+
+    // Appends one record (a single line without '\n'). The file is only
+    // created on the first record. Returns false if the record could not be
+    // written, in which case the change will not survive a restart.
+    bool append(const std::string& record) {
+        if (path.empty()) return true;
+
+        if (!fp) {
+            fp = std::fopen(path.c_str(), "ab");
+            if (!fp) return false;
+            std::fseek(fp, 0, SEEK_END);
+            if (std::ftell(fp) == 0) {
+                std::string header = stamp + "\n";
+                if (std::fwrite(header.data(), 1, header.size(), fp) != header.size() || std::fflush(fp) != 0) {
+                    close();
+                    std::remove(path.c_str()); // A partial stamp would hide the journal.
+                    return false;
+                }
+            }
+        }
+
+        bool ok = true;
+        if (needsNewline) ok = std::fputc('\n', fp) != EOF;
+        ok = ok && std::fwrite(record.data(), 1, record.size(), fp) == record.size();
+        ok = ok && std::fputc('\n', fp) != EOF;
+        ok = std::fflush(fp) == 0 && ok;
+
+        // After a failed write the file may end inside a record, so the next
+        // record starts on a line of its own, through a freshly opened file.
+        // Once a record is written in full the separator is no longer needed.
+        needsNewline = !ok;
+        if (!ok) close();
+        return ok;
+    }
+
+    // Deletes the journal file (its changes are now part of the snapshot).
+    void discard() {
+        close();
+        if (!path.empty()) std::remove(path.c_str());
+        needsNewline = false;
+    }
+
+    void close() {
+        if (fp) std::fclose(fp);
+        fp = nullptr;
+    }
+};
+
+// Appends a length-prefixed text field ("<length> <text>") to a journal record.
+void appendField(std::string& record, std::string_view text) {
+    record += ' ';
+    record += std::to_string(text.size());
+    record += ' ';
+    record.append(text);
+}
+
+// Reads the space-separated parts of a journal record.
+class RecordReader {
+private:
+    std::string_view rest;
+
+public:
+    explicit RecordReader(std::string_view record) : rest(record) {}
+
+    // Next word up to a space or the end of the record.
+    std::string_view token() {
+        size_t space = rest.find(' ');
+        std::string_view t = rest.substr(0, space);
+        rest.remove_prefix(space == std::string_view::npos ? rest.size() : space + 1);
+        return t;
+    }
+
+    // Next length-prefixed field written by appendField.
+    bool field(std::string_view& text) {
+        std::string_view len = token();
+        size_t n = 0;
+        std::from_chars_result r = std::from_chars(len.data(), len.data() + len.size(), n);
+        if (r.ec != std::errc() || r.ptr != len.data() + len.size() || len.empty() || n > rest.size())
+            return false;
+        text = rest.substr(0, n);
+        rest.remove_prefix(n);
+        if (!rest.empty()) {
+            if (rest[0] != ' ') return false;
+            rest.remove_prefix(1);
+        }
+        return true;
+    }
+
+    bool atEnd() const { return rest.empty(); }
+};
+
+// Splits "date,category,amount,description" into trimmed views over the line.
+// Missing fields are left empty; the description keeps any further commas.
+void splitCsvLine(std::string_view line, std::string_view fields[4]) {
+    for (int f = 0; f < 3; ++f) {
+        size_t comma = line.find(',');
+        if (comma == std::string_view::npos) {
+            fields[f] = trimView(line);
+            line = std::string_view();
+            for (int rest = f + 1; rest < 4; ++rest) fields[rest] = std::string_view();
+            return;
+        }
+        fields[f] = trimView(line.substr(0, comma));
+        line.remove_prefix(comma + 1);
+    }
+    fields[3] = trimView(line);
+}
+
+// A sort key and the row it belongs to.
+struct KeyedRow {
+    std::uint64_t key;
+    std::uint32_t row;
+};
+
+// Stable LSD radix sort of 'items' by key, one byte per pass. Keys are first
+// rebased on the smallest one, so only the low bytes that actually vary cost
+// a pass (a span of dates needs three, everyday amounts three or four).
+// Every pass is split among 'threads' workers (0 = one per core): each counts
+// the digits of its own slice, the counts become per-worker output offsets,
+// and each then scatters its slice, which keeps equal keys in input order.
+void radixSort(std::vector<KeyedRow>& items, unsigned threads = 0) {
+    if (items.size() < 2) return;
+
+    std::uint64_t lo = items[0].key, hi = items[0].key;
+    for (const KeyedRow& it : items) {
+        lo = std::min(lo, it.key);
+        hi = std::max(hi, it.key);
+    }
+    for (KeyedRow& it : items) it.key -= lo;
+
+    int passes = 0;
+    while (passes < 8 && ((hi - lo) >> (8 * passes)) != 0) ++passes;
+    if (passes == 0) return;
+
+    // Small inputs are not worth the thread start-up cost.
+    const size_t minRowsPerThread = 1 << 16;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, items.size() / minRowsPerThread + 1));
+
+    std::vector<KeyedRow> buffer(items.size());
+    std::vector<std::array<size_t, 256>> counts(threads);
+    auto sliceBegin = [&](unsigned t) { return items.size() / threads * t; };
+    auto sliceEnd = [&](unsigned t) { return t + 1 == threads ? items.size() : sliceBegin(t + 1); };
+
+    auto inParallel = [threads](auto work) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0u);
+        for (auto& w : workers) w.join();
+    };
+
+    for (int pass = 0; pass < passes; ++pass) {
+        const int shift = 8 * pass;
+
+        inParallel([&](unsigned t) {
+            std::array<size_t, 256>& c = counts[t];
+            c.fill(0);
+            for (size_t i = sliceBegin(t); i < sliceEnd(t); ++i) ++c[(items[i].key >> shift) & 0xFF];
+        });
+
+        // Digit-major, worker-minor: worker t's rows with digit d go after
+        // every earlier worker's rows with that digit.
+        size_t pos = 0;
+        for (int d = 0; d < 256; ++d) {
+            for (unsigned t = 0; t < threads; ++t) {
+                size_t n = counts[t][d];
+                counts[t][d] = pos;
+                pos += n;
+            }
         }
+
+        inParallel([&](unsigned t) {
+            std::array<size_t, 256>& next = counts[t];
+            for (size_t i = sliceBegin(t); i < sliceEnd(t); ++i)
+                buffer[next[(items[i].key >> shift) & 0xFF]++] = items[i];
+        });
+
+        items.swap(buffer);
     }
 }
 
 // Pauses the screen until the user presses ENTER.
-void pause() {
+void pauseScreen() {
     std::cout << "Press ENTER to continue...";
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
@@ -126,170 +758,2042 @@ void pause() {
 // ---------------------------- CLASSES --------------------------------
 // --------------------------------------------------------------------
 
+// Assigns a small integer id to every distinct category name, so that
+// transactions and budgets store the id instead of their own copy of the name.
+// Names are never removed, so an id stays valid for the whole program run.
+class CategoryDictionary {
+private:
+    std::deque<std::string> names; // A deque never moves its elements, so the
+                                   // views used as map keys stay valid.
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+
+public:
+    // Returns the id of 'name', adding it if it is new.
+    std::uint32_t intern(std::string_view name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+
+        std::uint32_t id = static_cast<std::uint32_t>(names.size());
+        names.emplace_back(name);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    // Looks up 'name' without adding it.
+    bool find(std::string_view name, std::uint32_t& id) const {
+        auto it = ids.find(name);
+        if (it == ids.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    const std::string& name(std::uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// The dictionary shared by all transactions and budgets.
+CategoryDictionary categories;
+
 // Represents a single financial transaction.
 class Transaction {
 private:
-    std::string date;        // Date of transaction (YYYY-MM-DD)
-    std::string category;    // Category (Food, Rent, Salary, etc.)
-    double amount;           // Positive = income, Negative = expense
+    std::uint32_t date;      // Date of transaction, packed as YYYYMMDD
+    std::uint32_t category;  // Id in 'categories' (Food, Rent, Salary, etc.)
+    Money amount;            // Positive = income, Negative = expense
     std::string description; // Extra details
 
 public:
-    Transaction() : date(""), category(""), amount(0), description("") {}
+    Transaction() : date(0), category(0), amount(0), description("") {}
 
-    // Full constructor
-    Transaction(const std::string& d, const std::string& c, double a, const std::string& desc)
+    // Full constructor ('d' is a date packed by validateDate, 'c' a category id)
+    Transaction(std::uint32_t d, std::uint32_t c, Money a, const std::string& desc)
         : date(d), category(c), amount(a), description(desc) {}
 
     // Getters
-    std::string getDate() const { return date; }
-    std::string getCategory() const { return category; }
-    double getAmount() const { return amount; }
-    std::string getDescription() const { return description; }
-
-    // Returns a formatted string to print the transaction.
-    std::string toString() const {
-        std::ostringstream oss;
-        oss << std::setw(10) << date << " | "
-            << std::setw(15) << category << " | "
-            << std::setw(10) << std::fixed << std::setprecision(2) << amount << " | "
-            << description;
-        return oss.str();
-    }
+    std::uint32_t getDate() const { return date; }
+    std::uint32_t getCategoryId() const { return category; }
+    const std::string& getCategory() const { return categories.name(category); }
+    Money getAmount() const { return amount; }
+    const std::string& getDescription() const { return description; }
 };
 
 // Stores a budget category with a spending limit.
 class Budget {
 private:
-    std::string category;
-    double limit;
+    std::uint32_t category; // Id in 'categories'
+    Money limit;
 
 public:
-    Budget() : category(""), limit(0) {}
+    Budget() : category(0), limit(0) {}
 
-    Budget(const std::string& c, double l)
+    Budget(std::uint32_t c, Money l)
         : category(c), limit(l) {}
 
-    std::string getCategory() const { return category; }
-    double getLimit() const { return limit; }
+    std::uint32_t getCategoryId() const { return category; }
+    const std::string& getCategory() const { return categories.name(category); }
+    Money getLimit() const { return limit; }
 
-    void setLimit(double l) { limit = l; }
+    void setLimit(Money l) { limit = l; }
 };
 
-// Main class managing all data: transactions + budgets.
-class FinanceManager {
+// Column-oriented (structure-of-arrays) storage for transactions. Each field
+// lives in its own contiguous array, and descriptions are slices of a single
+// string pool, so a scan over amounts or dates never touches the text.
+//
+// Every row gets a stable id when it is added. Deleting only marks the row
+// as a tombstone; dead rows are dropped later in one pass by compact() (or
+// by permute()), which renumbers rows but never changes ids. Binary
+// snapshots store the ids; only saving the ledger to a CSV file, which has
+// no room for them, renumbers ids (see renumberIds).
+class TransactionStore {
 private:
-    std::vector<Transaction> transactions;
-    std::vector<Budget> budgets;
+    std::vector<std::uint32_t> dates;       // Packed YYYYMMDD
+    std::vector<std::uint32_t> categoryIds; // Ids in 'categories'
+    std::vector<Money> amounts;
+    std::vector<std::uint64_t> descOffsets; // Start of each description in 'pool'
+    std::vector<std::uint32_t> descLengths;
+    std::vector<std::uint64_t> ids;         // Stable id of each row
+    std::vector<char> deleted;              // Tombstones (1 = deleted)
+    std::vector<std::uint32_t> rowOfId;     // Id → row, for live ids (NO_ROW once dropped)
+    std::string pool;                       // All descriptions, back to back
+    size_t unusedPoolBytes = 0;             // Left behind by deleted rows
+    size_t deletedRows = 0;
+    std::uint64_t nextId = 1;
+
+    static constexpr std::uint32_t NO_ROW = 0xFFFFFFFF;
+
+    void pushId() {
+        ids.push_back(nextId);
+        deleted.push_back(0);
+        rowOfId.resize(nextId + 1);
+        rowOfId[nextId] = static_cast<std::uint32_t>(ids.size() - 1);
+        ++nextId;
+    }
+
+    // Rebuilds the pool with only the descriptions still referenced.
+    void compactPool() {
+        std::string packed;
+        packed.reserve(pool.size() - unusedPoolBytes);
+        for (size_t i = 0; i < size(); ++i) {
+            std::uint64_t offset = packed.size();
+            packed.append(pool, descOffsets[i], descLengths[i]);
+            descOffsets[i] = offset;
+        }
+        pool.swap(packed);
+        unusedPoolBytes = 0;
+    }
 
 public:
-    FinanceManager() {}
+    // Number of rows, including tombstones (valid row numbers are 0..size()-1).
+    size_t size() const { return dates.size(); }
+    // Number of rows that are not deleted.
+    size_t liveCount() const { return dates.size() - deletedRows; }
+    bool empty() const { return liveCount() == 0; }
+    bool isDeleted(size_t i) const { return deleted[i] != 0; }
+    size_t deletedCount() const { return deletedRows; }
+
+    void clear() {
+        dates.clear();
+        categoryIds.clear();
+        amounts.clear();
+        descOffsets.clear();
+        descLengths.clear();
+        ids.clear();
+        deleted.clear();
+        rowOfId.clear();
+        pool.clear();
+        unusedPoolBytes = 0;
+        deletedRows = 0;
+        nextId = 1;
+    }
 
-    // Returns the number of transactions (used when deleting).
-    size_t getSize() const {
-        return transactions.size();
+    void reserve(size_t rows, size_t poolBytes) {
+        dates.reserve(rows);
+        categoryIds.reserve(rows);
+        amounts.reserve(rows);
+        descOffsets.reserve(rows);
+        descLengths.reserve(rows);
+        ids.reserve(rows);
+        deleted.reserve(rows);
+        rowOfId.reserve(rows + 1);
+        pool.reserve(poolBytes);
+    }
+
+    void append(std::uint32_t date, std::uint32_t categoryId, Money amount, std::string_view description) {
+        dates.push_back(date);
+        categoryIds.push_back(categoryId);
+        amounts.push_back(amount);
+        descOffsets.push_back(pool.size());
+        descLengths.push_back(static_cast<std::uint32_t>(description.size()));
+        pool.append(description);
+        pushId();
+    }
+
+    void append(const Transaction& t) {
+        append(t.getDate(), t.getCategoryId(), t.getAmount(), t.getDescription());
+    }
+
+    // Appends every row of 'other', which must not contain tombstones (used
+    // to splice loader chunks). The rows get new ids from this store.
+    void append(const TransactionStore& other) {
+        std::uint64_t base = pool.size();
+        dates.insert(dates.end(), other.dates.begin(), other.dates.end());
+        categoryIds.insert(categoryIds.end(), other.categoryIds.begin(), other.categoryIds.end());
+        amounts.insert(amounts.end(), other.amounts.begin(), other.amounts.end());
+        for (std::uint64_t offset : other.descOffsets) descOffsets.push_back(base + offset);
+        descLengths.insert(descLengths.end(), other.descLengths.begin(), other.descLengths.end());
+        pool.append(other.pool);
+        unusedPoolBytes += other.unusedPoolBytes;
+        for (size_t i = 0; i < other.size(); ++i) pushId();
+    }
+
+    // Finds the row of a live id in O(1).
+    bool findId(std::uint64_t id, size_t& row) const {
+        if (id == 0 || id >= nextId || rowOfId[id] == NO_ROW) return false;
+        row = rowOfId[id];
+        return row < ids.size() && ids[row] == id && !deleted[row];
+    }
+
+    // Turns row 'i' into a tombstone in O(1).
+    void markDeleted(size_t i) {
+        deleted[i] = 1;
+        ++deletedRows;
+        unusedPoolBytes += descLengths[i];
+    }
+
+    // True once tombstones make up a quarter of the rows, at which point a
+    // compaction pays for itself.
+    bool needsCompaction() const {
+        return deletedRows > 64 && deletedRows * 4 > size();
+    }
+
+    // Gives the rows ids 1..size() in row order, the ids that loading the
+    // rows back from a CSV file assigns. Requires that there are no
+    // tombstones. Returns true if any id changed.
+    bool renumberIds() {
+        bool changed = nextId != dates.size() + 1;
+        for (size_t i = 0; i < ids.size() && !changed; ++i) changed = ids[i] != i + 1;
+
+        ids.clear();
+        deleted.clear();
+        rowOfId.clear();
+        nextId = 1;
+        for (size_t i = 0; i < dates.size(); ++i) pushId();
+        return changed;
     }
 
-    // Adds a new transaction.
-    void addTransaction(const Transaction& t) {
-        transactions.push_back(t);
-        std::cout << "Transaction added successfully.\n";
+    // Keeps only the rows listed in 'order', so that new row i is old row
+    // order[i]. Rows left out (normally tombstones) are dropped.
+    void permute(const std::vector<size_t>& order) {
+        auto apply = [&order](auto& column) {
+            std::remove_reference_t<decltype(column)> sorted;
+            sorted.reserve(order.size());
+            for (size_t i : order) sorted.push_back(column[i]);
+            column.swap(sorted);
+        };
+
+        apply(dates);
+        apply(categoryIds);
+        apply(amounts);
+        apply(descOffsets);
+        apply(descLengths);
+        apply(ids);
+
+        deleted.assign(order.size(), 0);
+        deletedRows = 0;
+        std::fill(rowOfId.begin(), rowOfId.end(), NO_ROW); // Ids of dropped rows
+        for (size_t i = 0; i < ids.size(); ++i)
+            rowOfId[ids[i]] = static_cast<std::uint32_t>(i);
+
+        // Descriptions of rows left out no longer count as used.
+        size_t used = 0;
+        for (std::uint32_t length : descLengths) used += length;
+        unusedPoolBytes = pool.size() - used;
+        if (unusedPoolBytes > 4096 && unusedPoolBytes > pool.size() / 2)
+            compactPool();
+    }
+
+    // Drops all tombstones, keeping the remaining rows in order.
+    void compact() {
+        std::vector<size_t> order;
+        order.reserve(liveCount());
+        for (size_t i = 0; i < size(); ++i) {
+            if (!deleted[i]) order.push_back(i);
+        }
+        permute(order);
+    }
+
+    // Translates every category id through 'newId' (new = newId[old]).
+    void remapCategories(const std::vector<std::uint32_t>& newId) {
+        for (auto& c : categoryIds) c = newId[c];
+    }
+
+    // Column access.
+    std::uint32_t date(size_t i) const { return dates[i]; }
+    std::uint32_t categoryId(size_t i) const { return categoryIds[i]; }
+    Money amount(size_t i) const { return amounts[i]; }
+    std::uint64_t id(size_t i) const { return ids[i]; }
+    // The highest id of a live row (0 if there is none).
+    std::uint64_t highestId() const {
+        std::uint64_t top = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (!deleted[i]) top = std::max(top, ids[i]);
+        }
+        return top;
+    }
+
+    // Makes the next row added get highestId() + 1, the id a snapshot records
+    // for it. Ids that only deleted rows had above that are handed out again.
+    void trimNextId() {
+        nextId = highestId() + 1;
+        rowOfId.resize(nextId);
+    }
+    std::string_view description(size_t i) const {
+        return std::string_view(pool.data() + descOffsets[i], descLengths[i]);
+    }
+
+    const std::vector<std::uint32_t>& dateColumn() const { return dates; }
+    const std::vector<std::uint32_t>& categoryColumn() const { return categoryIds; }
+    const std::vector<Money>& amountColumn() const { return amounts; }
+    const std::vector<std::uint64_t>& descOffsetColumn() const { return descOffsets; }
+    const std::vector<std::uint32_t>& descLengthColumn() const { return descLengths; }
+    const std::vector<std::uint64_t>& idColumn() const { return ids; }
+    const std::vector<char>& deletedColumn() const { return deleted; }
+    const std::string& descriptionPool() const { return pool; }
+
+    // Replaces the contents with 'rows' rows copied column by column (used by
+    // the binary snapshot loader). Descriptions are slices of 'descriptions'.
+    // 'rowIds' must be distinct ids below 'firstFreeId', the id that the
+    // next row added gets. Throws std::bad_alloc if the ids are too large
+    // for the id table.
+    void assign(size_t rows, const std::uint32_t* d, const std::uint32_t* c, const Money* a,
+        const std::uint64_t* offsets, const std::uint32_t* lengths, std::string_view descriptions,
+        const std::uint64_t* rowIds, std::uint64_t firstFreeId) {
+        clear();
+        dates.assign(d, d + rows);
+        categoryIds.assign(c, c + rows);
+        amounts.assign(a, a + rows);
+        descOffsets.assign(offsets, offsets + rows);
+        descLengths.assign(lengths, lengths + rows);
+        pool.assign(descriptions);
+        ids.assign(rowIds, rowIds + rows);
+        deleted.assign(rows, 0);
+        nextId = firstFreeId;
+        rowOfId.assign(nextId, NO_ROW);
+        for (size_t i = 0; i < rows; ++i)
+            rowOfId[ids[i]] = static_cast<std::uint32_t>(i);
+    }
+};
+
+// Rows and diagnostics parsed from one newline-aligned slice of a CSV file.
+// Line numbers in 'errors' are relative to the start of the slice.
+struct CsvChunk {
+    TransactionStore rows;
+    std::vector<std::pair<int, bool>> errors; // (line, true = bad date / false = bad amount)
+    int lineCount = 0;
+    CategoryDictionary localCategories; // Used by worker threads, see loadFromFile.
+};
+
+// Parses every line of 'data' into 'out', interning categories into 'dict'.
+void parseCsvChunk(std::string_view data, CsvChunk& out, CategoryDictionary& dict) {
+    while (!data.empty()) {
+        const void* nl = std::memchr(data.data(), '\n', data.size());
+        size_t lineLength = nl ? static_cast<const char*>(nl) - data.data() : data.size();
+        std::string_view line = data.substr(0, lineLength);
+        data.remove_prefix(nl ? lineLength + 1 : lineLength);
+        out.lineCount++;
+
+        std::string_view fields[4];
+        splitCsvLine(line, fields);
+
+        std::uint32_t date;
+        if (!validateDate(fields[0], date)) {
+            out.errors.emplace_back(out.lineCount, true);
+            continue;
+        }
+
+        Money amount;
+        if (!parseMoney(fields[2], amount)) {
+            out.errors.emplace_back(out.lineCount, false);
+            continue;
+        }
+
+        out.rows.append(date, dict.intern(fields[1]), amount, fields[3]);
+    }
+}
+
+// Header of the binary snapshot format. A snapshot stores the ledger column
+// by column so it can be loaded with a handful of bulk copies:
+//
+//   SnapshotHeader
+//   Money         amounts[rows]
+//   uint64_t      descriptionOffsets[rows]   (into the description pool)
+//   uint64_t      ids[rows]                   (transaction ids, all below nextId)
+//   uint64_t      categoryEnds[categoryCount] (end of each name in the category pool)
+//   Money         budgetLimits[budgetCount]
+//   uint32_t      dates[rows]                 (packed YYYYMMDD)
+//   uint32_t      categoryIds[rows]
+//   uint32_t      descriptionLengths[rows]
+//   uint32_t      budgetCategories[budgetCount]
+//   char          categoryPool[categoryPoolBytes]
+//   char          descriptionPool[descriptionPoolBytes]
+//
+// 8-byte columns come first, so every column is naturally aligned. Numbers
+// are stored in the byte order of the machine that wrote the file; 'byteOrder'
+// lets a reader on a different machine reject it.
+struct SnapshotHeader {
+    char magic[8];                      // "PFMSNAP" + '\0'
+    std::uint32_t version;
+    std::uint32_t byteOrder;            // 0x01020304 as written
+    std::uint64_t rows;
+    std::uint64_t categoryCount;
+    std::uint64_t budgetCount;
+    std::uint64_t categoryPoolBytes;
+    std::uint64_t descriptionPoolBytes;
+    std::uint64_t nextId;               // Id the next new transaction gets
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+const char SNAPSHOT_MAGIC[8] = { 'P', 'F', 'M', 'S', 'N', 'A', 'P', '\0' };
+const std::uint32_t SNAPSHOT_VERSION = 2;
+const std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Appends the raw bytes of a column to a snapshot.
+template <typename T>
+void writeColumn(BufferedWriter& out, const T* values, size_t count) {
+    out.append(std::string_view(reinterpret_cast<const char*>(values), count * sizeof(T)));
+}
+
+// Criteria for selecting transactions in bulk. Every condition must hold;
+// the defaults match everything.
+struct TransactionFilter {
+    std::uint32_t fromDate = 0;                                 // Inclusive, packed YYYYMMDD
+    std::uint32_t toDate = std::numeric_limits<std::uint32_t>::max();
+    bool byCategory = false;
+    std::string category;                                       // Exact name, if byCategory
+    Money minAmount = std::numeric_limits<Money>::min();        // Inclusive
+    Money maxAmount = std::numeric_limits<Money>::max();
+    std::string descriptionContains;                            // Empty = any
+};
+
+// Income/expense totals of one calendar month.
+struct MonthBucket {
+    Money income = 0;
+    Money expense = 0;
+};
+
+// Transactions grouped by month (key YYYYMM), so that a monthly summary is a
+// lookup instead of a scan over the whole ledger.
+class MonthIndex {
+private:
+    std::unordered_map<std::uint32_t, MonthBucket> buckets;
+
+public:
+    void clear() { buckets.clear(); }
+
+    void add(std::uint32_t date, Money amount) {
+        MonthBucket& b = buckets[date / 100];
+        if (amount >= 0) b.income += amount;
+        else b.expense += amount;
+    }
+
+    // Removes a transaction that is being deleted from the store.
+    void erase(std::uint32_t date, Money amount) {
+        MonthBucket& b = buckets[date / 100];
+        if (amount >= 0) b.income -= amount;
+        else b.expense -= amount;
+    }
+
+    // Rebuilds the index from every live row of 'store'.
+    void rebuild(const TransactionStore& store) {
+        buckets.clear();
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!store.isDeleted(i)) add(store.date(i), store.amount(i));
+        }
+    }
+
+    // Returns the bucket of 'yearMonth' (YYYYMM), or nullptr if it has no rows.
+    const MonthBucket* find(std::uint32_t yearMonth) const {
+        auto it = buckets.find(yearMonth);
+        return it == buckets.end() ? nullptr : &it->second;
+    }
+};
+
+// A sorted sequence held in chunks of at most 2 * CHUNK elements, so that an
+// insert shifts one chunk instead of everything after it: one binary search
+// picks the chunk, a second the place inside it, and a chunk that grows too
+// big is split in two. Positions are (chunk, index) pairs; the end is
+// (number of chunks, 0).
+template <typename T>
+class ChunkedSequence {
+private:
+    static const size_t CHUNK = 512;
+
+    std::vector<std::vector<T>> chunks; // None empty
+
+public:
+    struct Position {
+        size_t chunk, index;
+    };
+
+    void clear() {
+        chunks.clear();
+        chunks.shrink_to_fit();
+    }
+
+    // Takes the elements of 'sorted', which must be in order.
+    void assign(const std::vector<T>& sorted) {
+        chunks.clear();
+        for (size_t i = 0; i < sorted.size(); i += CHUNK) {
+            size_t end = std::min(sorted.size(), i + CHUNK);
+            chunks.emplace_back(sorted.begin() + i, sorted.begin() + end);
+        }
+    }
+
+    // Inserts 'value' after the elements that are not greater than it.
+    template <typename Less>
+    void insert(const T& value, Less less) {
+        if (chunks.empty()) {
+            chunks.push_back({ value });
+            return;
+        }
+
+        // The first chunk that ends after 'value', else the last one.
+        auto chunk = std::upper_bound(chunks.begin(), chunks.end(), value,
+            [&less](const T& v, const std::vector<T>& c) { return less(v, c.back()); });
+        if (chunk == chunks.end()) --chunk;
+
+        chunk->insert(std::upper_bound(chunk->begin(), chunk->end(), value, less), value);
+
+        if (chunk->size() > 2 * CHUNK) {
+            std::vector<T> upper(chunk->begin() + CHUNK, chunk->end());
+            chunk->resize(CHUNK);
+            chunks.insert(chunk + 1, std::move(upper));
+        }
+    }
+
+    // Position of the first element not less than 'value'.
+    template <typename Less>
+    Position lowerBound(const T& value, Less less) const {
+        auto chunk = std::partition_point(chunks.begin(), chunks.end(),
+            [&](const std::vector<T>& c) { return less(c.back(), value); });
+        if (chunk == chunks.end()) return { chunks.size(), 0 };
+        return { size_t(chunk - chunks.begin()),
+                 size_t(std::lower_bound(chunk->begin(), chunk->end(), value, less) - chunk->begin()) };
+    }
+
+    // Position of the first element greater than 'value'.
+    template <typename Less>
+    Position upperBound(const T& value, Less less) const {
+        auto chunk = std::partition_point(chunks.begin(), chunks.end(),
+            [&](const std::vector<T>& c) { return !less(value, c.back()); });
+        if (chunk == chunks.end()) return { chunks.size(), 0 };
+        return { size_t(chunk - chunks.begin()),
+                 size_t(std::upper_bound(chunk->begin(), chunk->end(), value, less) - chunk->begin()) };
+    }
+
+    // Number of elements in [first, last).
+    size_t distance(Position first, Position last) const {
+        if (first.chunk == last.chunk) return last.index - first.index;
+        size_t n = chunks[first.chunk].size() - first.index + last.index;
+        for (size_t c = first.chunk + 1; c < last.chunk; ++c) n += chunks[c].size();
+        return n;
+    }
+
+    // Calls f(element) for every element in [first, last), in order.
+    template <typename F>
+    void forEach(Position first, Position last, F f) const {
+        for (size_t c = first.chunk; c <= last.chunk && c < chunks.size(); ++c) {
+            size_t begin = (c == first.chunk) ? first.index : 0;
+            size_t end = (c == last.chunk) ? last.index : chunks[c].size();
+            for (size_t i = begin; i < end; ++i) f(chunks[c][i]);
+        }
+    }
+
+    // Calls f(element) for every element, in order.
+    template <typename F>
+    void forEach(F f) const {
+        for (const auto& c : chunks) {
+            for (const T& x : c) f(x);
+        }
+    }
+
+    // Position of element number 'n' (the end if there are fewer), found
+    // by stepping over whole chunks.
+    Position position(size_t n) const {
+        size_t c = 0;
+        while (c < chunks.size() && n >= chunks[c].size()) n -= chunks[c++].size();
+        return c < chunks.size() ? Position{ c, n } : Position{ chunks.size(), 0 };
+    }
+
+    // Calls f(element) from 'first' on, in order, until f returns false.
+    template <typename F>
+    void forEachFrom(Position first, F f) const {
+        for (size_t c = first.chunk; c < chunks.size(); ++c) {
+            for (size_t i = (c == first.chunk) ? first.index : 0; i < chunks[c].size(); ++i) {
+                if (!f(chunks[c][i])) return;
+            }
+        }
+    }
+};
+
+// Rows ordered by date (ties in ledger order), so an exact date or an
+// inclusive date range is found by binary search in O(log n + k). Each entry
+// packs the date above the row number, which makes the sort order a plain
+// integer order. Deleted rows stay listed until the next rebuild, so readers
+// must skip tombstones.
+class DateIndex {
+private:
+    ChunkedSequence<std::uint64_t> entries;
+
+    static std::uint64_t key(std::uint32_t date, size_t row) {
+        return (static_cast<std::uint64_t>(date) << 32) | static_cast<std::uint32_t>(row);
+    }
+
+    typedef ChunkedSequence<std::uint64_t>::Position Position;
+
+    // The entries dated in [from, to].
+    std::pair<Position, Position> range(std::uint32_t from, std::uint32_t to) const {
+        std::less<std::uint64_t> less;
+        Position first = entries.lowerBound(key(from, 0), less);
+        if (from > to) return { first, first };
+        return { first, entries.upperBound(key(to, 0xFFFFFFFFu), less) };
+    }
+
+public:
+    // Adds row 'row', which must be newer than every row already listed.
+    void add(std::uint32_t date, size_t row) {
+        entries.insert(key(date, row), std::less<std::uint64_t>());
+    }
+
+    // Rebuilds the index from every live row of 'store'.
+    void rebuild(const TransactionStore& store) {
+        std::vector<std::uint64_t> sorted;
+        sorted.reserve(store.liveCount());
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!store.isDeleted(i)) sorted.push_back(key(store.date(i), i));
+        }
+        if (!std::is_sorted(sorted.begin(), sorted.end()))
+            std::sort(sorted.begin(), sorted.end());
+        entries.assign(sorted);
+    }
+
+    // Number of rows dated in [from, to].
+    size_t count(std::uint32_t from, std::uint32_t to) const {
+        auto [first, last] = range(from, to);
+        return entries.distance(first, last);
+    }
+
+    // Calls f(row) for every row dated in [from, to], in date order.
+    template <typename F>
+    void forEachInRange(std::uint32_t from, std::uint32_t to, F f) const {
+        auto [first, last] = range(from, to);
+        entries.forEach(first, last, [&f](std::uint64_t e) { f(static_cast<size_t>(e & 0xFFFFFFFFu)); });
+    }
+};
+
+// Inverted index from category id to the rows of that category (its posting
+// list, in ascending row order). Deleted rows stay listed until the next
+// rebuild, so readers must skip tombstones.
+class CategoryIndex {
+private:
+    std::vector<std::vector<std::uint32_t>> postings;
+
+public:
+    // Adds row 'row'; rows must be added in ascending order.
+    void add(std::uint32_t categoryId, size_t row) {
+        if (categoryId >= postings.size()) postings.resize(categoryId + 1);
+        postings[categoryId].push_back(static_cast<std::uint32_t>(row));
+    }
+
+    // Rebuilds the index from every live row of 'store'.
+    void rebuild(const TransactionStore& store) {
+        postings.assign(categories.size(), std::vector<std::uint32_t>());
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!store.isDeleted(i)) add(store.categoryId(i), i);
+        }
+    }
+
+    // Rows of one category (may include tombstones).
+    const std::vector<std::uint32_t>& rows(std::uint32_t categoryId) const {
+        static const std::vector<std::uint32_t> none;
+        return categoryId < postings.size() ? postings[categoryId] : none;
+    }
+};
+
+// Full-text index over descriptions: every word maps to the rows containing
+// it (ascending). Words are runs of letters and digits, with ASCII folded to
+// lower case; bytes of multi-byte UTF-8 characters count as letters. The
+// vocabulary is also kept in sorted order so that a prefix is a binary
+// search. Deleted rows stay listed until the next rebuild, so readers must
+// skip tombstones.
+//
+// Tokenizing a whole ledger costs several times more than parsing it, so the
+// index is only built by the first text search (build()); from then on it is
+// kept up to date like the other indexes until the next reset().
+class TokenIndex {
+private:
+    bool built = false;
+    std::deque<std::string> terms; // Stable storage for the map keys
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+    std::vector<std::vector<std::uint32_t>> postings; // By term id
+    std::vector<std::uint32_t> sorted;                // Term ids in word order
+
+    bool termLess(std::uint32_t a, std::string_view b) const { return terms[a] < b; }
+
+    // The entries of 'sorted' whose word starts with 'prefix'.
+    std::pair<const std::uint32_t*, const std::uint32_t*> prefixRange(std::string_view prefix) const {
+        auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+            [this](std::uint32_t a, std::string_view b) { return termLess(a, b); });
+        auto last = first;
+        while (last != sorted.end() && terms[*last].compare(0, prefix.size(), prefix) == 0) ++last;
+        return { sorted.data() + (first - sorted.begin()), sorted.data() + (last - sorted.begin()) };
+    }
+
+    // Adds 'row' to the posting list of 'word'; a new word is appended to
+    // the vocabulary and, if 'keepSorted', inserted into 'sorted' too.
+    void addWord(const std::string& word, std::uint32_t row, bool keepSorted) {
+        auto it = ids.find(word);
+        std::uint32_t id;
+        if (it != ids.end()) {
+            id = it->second;
+        }
+        else {
+            id = static_cast<std::uint32_t>(terms.size());
+            terms.push_back(word);
+            ids.emplace(terms.back(), id);
+            postings.emplace_back();
+            if (keepSorted) {
+                auto pos = std::lower_bound(sorted.begin(), sorted.end(), std::string_view(word),
+                    [this](std::uint32_t a, std::string_view b) { return termLess(a, b); });
+                sorted.insert(pos, id);
+            }
+            else {
+                sorted.push_back(id);
+            }
+        }
+        std::vector<std::uint32_t>& list = postings[id];
+        if (list.empty() || list.back() != row) list.push_back(row);
+    }
+
+    void addText(std::string_view text, size_t row, bool keepSorted) {
+        forEachWord(text, [&](const std::string& word) {
+            addWord(word, static_cast<std::uint32_t>(row), keepSorted);
+        });
+    }
+
+public:
+    // Calls f(word) for every case-folded word of 'text'.
+    template <typename F>
+    static void forEachWord(std::string_view text, F f) {
+        std::string word;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+            if (isalnum(c) || c >= 0x80) {
+                word += static_cast<char>(tolower(c));
+            }
+            else if (!word.empty()) {
+                f(word);
+                word.clear();
+            }
+        }
+    }
+
+    bool isBuilt() const { return built; }
+
+    // Adds row 'row'; rows must be added in ascending order. Does nothing
+    // while the index is not built.
+    void add(std::string_view description, size_t row) {
+        if (built) addText(description, row, true);
+    }
+
+    // Drops the index; the next build() starts from scratch.
+    void reset() {
+        built = false;
+        terms.clear();
+        ids.clear();
+        postings.clear();
+        sorted.clear();
+    }
+
+    // Builds the index from every live row of 'store'.
+    void build(const TransactionStore& store) {
+        reset();
+        built = true;
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!store.isDeleted(i)) addText(store.description(i), i, false);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [this](std::uint32_t a, std::uint32_t b) { return terms[a] < terms[b]; });
+    }
+
+    // Rows containing a word that starts with 'prefix' (ascending, may
+    // include tombstones).
+    std::vector<std::uint32_t> rowsWithPrefix(std::string_view prefix) const {
+        auto [first, last] = prefixRange(prefix);
+        if (last - first == 1) return postings[*first];
+
+        std::vector<std::uint32_t> rows;
+        for (auto it = first; it != last; ++it)
+            rows.insert(rows.end(), postings[*it].begin(), postings[*it].end());
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        return rows;
+    }
+
+    // Upper bound on rowsWithPrefix(prefix).size(), without building it.
+    size_t countWithPrefix(std::string_view prefix) const {
+        auto [first, last] = prefixRange(prefix);
+        size_t n = 0;
+        for (auto it = first; it != last; ++it) n += postings[*it].size();
+        return n;
+    }
+};
+
+// Substring index over descriptions: every run of three bytes (trigram) maps
+// to the rows whose description contains it. A query of three or more bytes
+// intersects the lists of its own trigrams, and only the surviving rows are
+// checked with a real find(). Trigrams are hashed into a fixed number of
+// buckets, so a list may also hold rows of other trigrams; the final check
+// removes those. Like TokenIndex, it is built by the first search that needs
+// it and then kept up to date until reset(); deleted rows stay listed until
+// then, so readers must skip tombstones.
+class TrigramIndex {
+private:
+    std::vector<std::vector<std::uint32_t>> buckets; // Empty = not built
+
+    std::uint32_t bucketOf(const char* p) const {
+        std::uint32_t gram = (static_cast<unsigned char>(p[0]) << 16) |
+                             (static_cast<unsigned char>(p[1]) << 8) |
+                             static_cast<unsigned char>(p[2]);
+        return (gram * 2654435761u) >> 8 & static_cast<std::uint32_t>(buckets.size() - 1);
+    }
+
+public:
+    static constexpr size_t MIN_QUERY = 3;
+
+    bool isBuilt() const { return !buckets.empty(); }
+
+    // Adds row 'row'; rows must be added in ascending order. Does nothing
+    // while the index is not built.
+    void add(std::string_view text, size_t row) {
+        if (!isBuilt()) return;
+        std::uint32_t r = static_cast<std::uint32_t>(row);
+        for (size_t i = 0; i + MIN_QUERY <= text.size(); ++i) {
+            std::vector<std::uint32_t>& list = buckets[bucketOf(text.data() + i)];
+            if (list.empty() || list.back() != r) list.push_back(r);
+        }
+    }
+
+    void reset() { buckets.clear(); buckets.shrink_to_fit(); }
+
+    // Builds the index from every live row of 'store', with about one
+    // bucket per 16 rows (between 2^12 and 2^20 buckets).
+    void build(const TransactionStore& store) {
+        size_t count = size_t(1) << 12;
+        while (count < (size_t(1) << 20) && count * 16 < store.liveCount()) count <<= 1;
+        buckets.assign(count, std::vector<std::uint32_t>());
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!store.isDeleted(i)) add(store.description(i), i);
+        }
+    }
+
+    // Upper bound on candidates(query).size(): its smallest bucket.
+    size_t estimate(std::string_view query) const {
+        size_t n = std::numeric_limits<size_t>::max();
+        for (size_t i = 0; i + MIN_QUERY <= query.size(); ++i)
+            n = std::min(n, buckets[bucketOf(query.data() + i)].size());
+        return n;
+    }
+
+    // Candidate rows for 'query' (at least MIN_QUERY bytes): a superset of
+    // the rows containing it, ascending, possibly with tombstones.
+    std::vector<std::uint32_t> candidates(std::string_view query) const {
+        std::vector<const std::vector<std::uint32_t>*> lists;
+        for (size_t i = 0; i + MIN_QUERY <= query.size(); ++i)
+            lists.push_back(&buckets[bucketOf(query.data() + i)]);
+        std::sort(lists.begin(), lists.end());
+        lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::vector<std::uint32_t>* a, const std::vector<std::uint32_t>* b) {
+                      return a->size() < b->size();
+                  });
+
+        std::vector<std::uint32_t> rows = *lists[0];
+        for (size_t i = 1; i < lists.size() && !rows.empty(); ++i) {
+            std::vector<std::uint32_t> both;
+            std::set_intersection(rows.begin(), rows.end(), lists[i]->begin(), lists[i]->end(),
+                                  std::back_inserter(both));
+            rows.swap(both);
+        }
+        return rows;
+    }
+};
+
+// A search condition. Leaves test one field; AND/OR nodes combine their
+// children. Build one with the factory functions and run it with
+// FinanceManager::forEachMatch, which picks the index to start from.
+struct Query {
+    enum Kind { ANY, DATE_RANGE, CATEGORIES, AMOUNT_RANGE, TEXT, WORDS, AND, OR };
+
+    Kind kind = ANY;
+    std::uint32_t fromDate = 0, toDate = 0;  // DATE_RANGE, inclusive
+    std::vector<std::uint32_t> categoryIds;  // CATEGORIES, ascending and distinct
+    Money minAmount = 0, maxAmount = 0;      // AMOUNT_RANGE, inclusive
+    std::string text;                        // TEXT: part of the description
+    std::vector<std::string> words;          // WORDS: beginnings of description words
+    std::vector<Query> children;             // AND, OR
+
+    static Query any() { return Query(); }
+
+    static Query dateRange(std::uint32_t from, std::uint32_t to) {
+        Query q;
+        q.kind = DATE_RANGE;
+        q.fromDate = from;
+        q.toDate = to;
+        return q;
+    }
+
+    static Query inCategories(std::vector<std::uint32_t> ids) {
+        Query q;
+        q.kind = CATEGORIES;
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        q.categoryIds = std::move(ids);
+        return q;
+    }
+
+    // Every category whose name contains 'part'.
+    static Query categoryNameContains(std::string_view part) {
+        std::vector<std::uint32_t> ids;
+        for (std::uint32_t id = 0; id < categories.size(); ++id) {
+            if (categories.name(id).find(part) != std::string::npos) ids.push_back(id);
+        }
+        return inCategories(std::move(ids));
+    }
+
+    static Query amountRange(Money min, Money max) {
+        Query q;
+        q.kind = AMOUNT_RANGE;
+        q.minAmount = min;
+        q.maxAmount = max;
+        return q;
+    }
+
+    static Query descriptionContains(std::string part) {
+        Query q;
+        q.kind = TEXT;
+        q.text = std::move(part);
+        return q;
+    }
+
+    // Descriptions with a word starting with each word of 'text' (see
+    // TokenIndex); a text without words matches nothing.
+    static Query descriptionWords(std::string_view text) {
+        Query q;
+        q.kind = WORDS;
+        TokenIndex::forEachWord(text, [&q](const std::string& word) { q.words.push_back(word); });
+        return q;
+    }
+
+    static Query allOf(std::vector<Query> parts) {
+        Query q;
+        q.kind = AND;
+        q.children = std::move(parts);
+        return q;
+    }
+
+    static Query anyOf(std::vector<Query> parts) {
+        Query q;
+        q.kind = OR;
+        q.children = std::move(parts);
+        return q;
+    }
+
+    // The conditions set in 'filter', joined by AND (or by OR with
+    // 'matchAny'). A filter with no conditions matches everything.
+    static Query fromFilter(const TransactionFilter& filter, bool matchAny = false) {
+        std::vector<Query> parts;
+        if (filter.fromDate != 0 || filter.toDate != std::numeric_limits<std::uint32_t>::max())
+            parts.push_back(dateRange(filter.fromDate, filter.toDate));
+        if (filter.byCategory) {
+            std::vector<std::uint32_t> ids;
+            std::uint32_t id;
+            if (categories.find(filter.category, id)) ids.push_back(id);
+            parts.push_back(inCategories(std::move(ids)));
+        }
+        if (filter.minAmount != std::numeric_limits<Money>::min() ||
+            filter.maxAmount != std::numeric_limits<Money>::max())
+            parts.push_back(amountRange(filter.minAmount, filter.maxAmount));
+        if (!filter.descriptionContains.empty())
+            parts.push_back(descriptionContains(filter.descriptionContains));
+
+        if (parts.empty()) return any();
+        if (parts.size() == 1) return std::move(parts[0]);
+        return matchAny ? anyOf(std::move(parts)) : allOf(std::move(parts));
+    }
+
+    // Tests live or dead row 'i' of 'store'.
+    bool matches(const TransactionStore& store, size_t i) const {
+        switch (kind) {
+        case DATE_RANGE:
+            return store.date(i) >= fromDate && store.date(i) <= toDate;
+        case CATEGORIES:
+            return std::binary_search(categoryIds.begin(), categoryIds.end(), store.categoryId(i));
+        case AMOUNT_RANGE:
+            return store.amount(i) >= minAmount && store.amount(i) <= maxAmount;
+        case TEXT:
+            return store.description(i).find(text) != std::string_view::npos;
+        case WORDS: {
+            if (words.empty()) return false;
+            std::vector<std::string> own;
+            TokenIndex::forEachWord(store.description(i), [&own](const std::string& w) { own.push_back(w); });
+            for (const std::string& wanted : words) {
+                bool found = false;
+                for (const std::string& w : own) {
+                    if (w.compare(0, wanted.size(), wanted) == 0) { found = true; break; }
+                }
+                if (!found) return false;
+            }
+            return true;
+        }
+        case AND:
+            for (const Query& c : children) {
+                if (!c.matches(store, i)) return false;
+            }
+            return true;
+        case OR:
+            for (const Query& c : children) {
+                if (c.matches(store, i)) return true;
+            }
+            return false;
+        default:
+            return true;
+        }
+    }
+};
+
+// One field of a sort order.
+struct SortField {
+    enum Column { DATE, AMOUNT, CATEGORY };
+
+    Column column;
+    bool descending;
+};
+
+// Fields compared in turn, ties left in order of entry. An empty order is
+// the order of entry itself.
+typedef std::vector<SortField> SortOrder;
+
+// Journal form of an order: a letter (d, a, c) and a direction (+, -) per
+// field, e.g. "c+d-"; "0" for the order of entry.
+std::string orderCode(const SortOrder& order) {
+    if (order.empty()) return "0";
+    std::string code;
+    for (const SortField& f : order) {
+        code += "dac"[f.column];
+        code += f.descending ? '-' : '+';
+    }
+    return code;
+}
+
+// Parses orderCode's output; the single digits 1-4 written by older
+// journals (date, amount, category, order of entry) are also accepted.
+bool parseOrderCode(std::string_view code, SortOrder& order) {
+    order.clear();
+    if (code == "0" || code == "4") return true;
+    if (code == "1") code = "d+";
+    else if (code == "2") code = "a+";
+    else if (code == "3") code = "c+";
+
+    if (code.empty() || code.size() % 2 != 0) return false;
+    for (size_t i = 0; i < code.size(); i += 2) {
+        const char* letter = std::strchr("dac", code[i]);
+        if (!letter || code[i] == '\0' || (code[i + 1] != '+' && code[i + 1] != '-')) return false;
+        order.push_back({ static_cast<SortField::Column>(letter - "dac"), code[i + 1] == '-' });
+    }
+    return true;
+}
+
+// The live rows in one sort order, kept beside the ledger instead of
+// reordering it. Built on first use; after that a new row is inserted in
+// place (see ChunkedSequence), while deleted rows stay listed until the next
+// reset, so readers must skip tombstones.
+class SortedView {
+private:
+    ChunkedSequence<std::uint32_t> rows;
+    bool built = false;
+
+public:
+    bool isBuilt() const { return built; }
+
+    void reset() {
+        built = false;
+        rows.clear();
+    }
+
+    // Takes the live rows, already sorted.
+    void assign(const std::vector<std::uint32_t>& sorted) {
+        rows.assign(sorted);
+        built = true;
+    }
+
+    // Adds row 'row', which must be newer than every row already listed;
+    // before(a, b) is the order's comparison, with ties broken by row.
+    // Does nothing while not built.
+    template <typename Before>
+    void add(size_t row, Before before) {
+        if (built) rows.insert(static_cast<std::uint32_t>(row), before);
+    }
+
+    // Calls f(row) for every listed row, in order.
+    template <typename F>
+    void forEach(F f) const { rows.forEach(f); }
+
+    // Calls f(row) for the listed rows from number 'n' on, until f returns
+    // false.
+    template <typename F>
+    void forEachFrom(size_t n, F f) const { rows.forEachFrom(rows.position(n), f); }
+};
+
+TransactionFilter inputFilter(); // Defined with the menu helpers below
+
+// Main class managing all data: transactions + budgets.
+class FinanceManager {
+private:
+    TransactionStore transactions;
+    std::vector<Budget> budgets;
+    MonthIndex months; // Kept in sync with 'transactions'
+    CategoryIndex byCategory; // Kept in sync with 'transactions'
+    DateIndex byDate; // Kept in sync with 'transactions'
+    mutable TokenIndex byWord; // Built on first use, then kept in sync
+    mutable TrigramIndex byTrigram; // Built on first use, then kept in sync
+    SortOrder listOrder; // Order of listings and saved files
+    mutable std::map<std::string, SortedView> views; // By orderCode; built on first use
+    std::vector<Money> spentPerCategory; // Category id → total spent, kept in sync
+    Journal journal;   // Changes since the ledger file was last loaded or saved
+
+    // Adds 'delta' to the spending total of a category.
+    void addSpending(std::uint32_t categoryId, Money delta) {
+        if (categoryId >= spentPerCategory.size())
+            spentPerCategory.resize(categoryId + 1);
+        spentPerCategory[categoryId] += delta;
+    }
+
+    Money spentOn(std::uint32_t categoryId) const {
+        return categoryId < spentPerCategory.size() ? spentPerCategory[categoryId] : 0;
+    }
+
+    // Recomputes every derived index from 'transactions'.
+    void rebuildIndexes() {
+        months.rebuild(transactions);
+        byCategory.rebuild(transactions);
+        byDate.rebuild(transactions);
+        byWord.reset();
+        byTrigram.reset();
+        views.clear();
+
+        const std::vector<std::uint32_t>& ids = transactions.categoryColumn();
+        const std::vector<Money>& amounts = transactions.amountColumn();
+        const std::vector<char>& deleted = transactions.deletedColumn();
+
+        spentPerCategory.assign(categories.size(), 0);
+        for (size_t i = 0; i < amounts.size(); ++i) {
+            if (amounts[i] < 0 && !deleted[i]) {
+                spentPerCategory[ids[i]] += (-amounts[i]);
+            }
+        }
+    }
+
+    // The apply* functions below change the ledger and its indexes without
+    // printing or journaling; they are shared by the menu and by replay.
+
+    void applyAdd(const Transaction& t) {
+        transactions.append(t);
+        months.add(t.getDate(), t.getAmount());
+        byCategory.add(t.getCategoryId(), transactions.size() - 1);
+        byDate.add(t.getDate(), transactions.size() - 1);
+        byWord.add(t.getDescription(), transactions.size() - 1);
+        byTrigram.add(t.getDescription(), transactions.size() - 1);
+        for (auto& [code, v] : views) {
+            SortOrder order;
+            parseOrderCode(code, order);
+            v.add(transactions.size() - 1, [&](size_t a, size_t b) { return listedBefore(order, a, b); });
+        }
+        if (t.getAmount() < 0)
+            addSpending(t.getCategoryId(), -t.getAmount());
+    }
+
+    // Deletes the transaction with stable id 'id' in O(1) (amortized: the
+    // tombstones are compacted once they make up a quarter of the rows).
+    bool applyDelete(std::uint64_t id) {
+        size_t row;
+        if (!transactions.findId(id, row)) return false;
+
+        months.erase(transactions.date(row), transactions.amount(row));
+        if (transactions.amount(row) < 0)
+            addSpending(transactions.categoryId(row), transactions.amount(row));
+        transactions.markDeleted(row);
+
+        if (transactions.needsCompaction()) {
+            transactions.compact();
+            rebuildIndexes();
+        }
+        return true;
+    }
+
+    size_t applyDeleteMatching(const TransactionFilter& filter) {
+        size_t removed = 0;
+        forEachMatch(Query::fromFilter(filter), [&](size_t row) {
+            transactions.markDeleted(row);
+            ++removed;
+        });
+
+        if (removed > 0) {
+            transactions.compact();
+            rebuildIndexes();
+        }
+        return removed;
+    }
+
+    // Lists in 'order' from now on. The ledger itself keeps its order, so
+    // the indexes stay valid and switching back is free once the view of
+    // each order has been built.
+    void applyOrder(const SortOrder& order) { listOrder = order; }
+
+    // Compares one field of rows a and b: negative, zero or positive.
+    int compareField(SortField::Column column, size_t a, size_t b) const {
+        switch (column) {
+        case SortField::DATE:
+            return (transactions.date(a) > transactions.date(b)) - (transactions.date(a) < transactions.date(b));
+        case SortField::AMOUNT:
+            return (transactions.amount(a) > transactions.amount(b)) - (transactions.amount(a) < transactions.amount(b));
+        default:
+            return categories.name(transactions.categoryId(a)).compare(categories.name(transactions.categoryId(b)));
+        }
+    }
+
+    // True if row a is listed before row b in 'order' (ties by row).
+    bool listedBefore(const SortOrder& order, size_t a, size_t b) const {
+        for (const SortField& f : order) {
+            int c = compareField(f.column, a, b);
+            if (c != 0) return f.descending ? c > 0 : c < 0;
+        }
+        return a < b;
+    }
+
+    // Sorts 'rows' by 'order'. Every field is turned into an unsigned number
+    // that sorts the same way (amounts get their sign bit flipped,
+    // categories become their rank by name, descending fields are
+    // subtracted from their maximum) and rebased on its minimum. If the
+    // fields then fit in 64 bits together, they are packed into one key per
+    // row and radix sorted, so a composite order costs the same as a single
+    // field. Otherwise the rows are stable sorted field by field.
+    void sortRows(const SortOrder& order, std::vector<std::uint32_t>& rows) const {
+        if (order.empty() || rows.empty()) return;
+
+        std::vector<std::uint32_t> rank(categories.size());
+        for (std::uint32_t id = 0; id < rank.size(); ++id) rank[id] = id;
+        std::sort(rank.begin(), rank.end(), [](std::uint32_t a, std::uint32_t b) {
+            return categories.name(a) < categories.name(b);
+        });
+        std::vector<std::uint32_t> rankOf(rank.size());
+        for (std::uint32_t r = 0; r < rank.size(); ++r) rankOf[rank[r]] = r;
+
+        auto value = [&](SortField::Column column, size_t row) -> std::uint64_t {
+            if (column == SortField::DATE) return transactions.date(row);
+            if (column == SortField::AMOUNT)
+                return static_cast<std::uint64_t>(transactions.amount(row)) ^ (std::uint64_t(1) << 63);
+            return rankOf[transactions.categoryId(row)];
+        };
+
+        std::vector<std::uint64_t> lo(order.size()), hi(order.size());
+        std::vector<int> width(order.size());
+        int totalWidth = 0;
+        for (size_t f = 0; f < order.size(); ++f) {
+            lo[f] = hi[f] = value(order[f].column, rows[0]);
+            for (std::uint32_t row : rows) {
+                std::uint64_t v = value(order[f].column, row);
+                lo[f] = std::min(lo[f], v);
+                hi[f] = std::max(hi[f], v);
+            }
+            while (width[f] < 64 && ((hi[f] - lo[f]) >> width[f]) != 0) ++width[f];
+            totalWidth += width[f];
+        }
+
+        if (totalWidth > 64) {
+            std::stable_sort(rows.begin(), rows.end(), [&](std::uint32_t a, std::uint32_t b) {
+                return listedBefore(order, a, b);
+            });
+            return;
+        }
+
+        std::vector<KeyedRow> keyed(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            std::uint64_t key = 0;
+            for (size_t f = 0; f < order.size(); ++f) {
+                std::uint64_t v = value(order[f].column, rows[i]);
+                std::uint64_t part = order[f].descending ? hi[f] - v : v - lo[f];
+                key = (width[f] < 64 ? key << width[f] : 0) | part;
+            }
+            keyed[i] = { key, rows[i] };
+        }
+        radixSort(keyed);
+
+        for (size_t i = 0; i < keyed.size(); ++i) rows[i] = keyed[i].row;
+    }
+
+    // The live rows in 'order'. A ledger that was saved in this order and
+    // loaded back is sorted except for the rows added since, so the rows
+    // already in order at the front are found with one linear pass; only
+    // the rest is sorted, then merged in linearly.
+    std::vector<std::uint32_t> listedRows(const SortOrder& order) const {
+        std::vector<std::uint32_t> rows;
+        rows.reserve(transactions.liveCount());
+        for (size_t i = 0; i < transactions.size(); ++i) {
+            if (!transactions.isDeleted(i)) rows.push_back(static_cast<std::uint32_t>(i));
+        }
+
+        auto before = [&](std::uint32_t a, std::uint32_t b) { return listedBefore(order, a, b); };
+        size_t sorted = 1;
+        while (sorted < rows.size() && before(rows[sorted - 1], rows[sorted])) ++sorted;
+        if (sorted >= rows.size()) return rows;
+
+        std::vector<std::uint32_t> rest(rows.begin() + sorted, rows.end());
+        sortRows(order, rest);
+        std::copy(rest.begin(), rest.end(), rows.begin() + sorted);
+        std::inplace_merge(rows.begin(), rows.begin() + sorted, rows.end(), before);
+        return rows;
+    }
+
+    // The view for 'order' (not empty), built if needed. Only a few views
+    // are cached, since every one of them is updated on each add.
+    const SortedView& view(const SortOrder& order) const {
+        std::string code = orderCode(order);
+        if (views.size() >= 4 && views.count(code) == 0) views.clear();
+
+        SortedView& v = views[code];
+        if (!v.isBuilt()) v.assign(listedRows(order));
+        return v;
+    }
+
+    // Calls f(row) for every live row, in listing order.
+    template <typename F>
+    void forEachListed(F f) const {
+        if (listOrder.empty()) {
+            for (size_t i = 0; i < transactions.size(); ++i) {
+                if (!transactions.isDeleted(i)) f(i);
+            }
+            return;
+        }
+        view(listOrder).forEach([&](std::uint32_t row) {
+            if (!transactions.isDeleted(row)) f(row);
+        });
+    }
+
+    // Live rows offset .. offset + limit - 1 of the listing. Without
+    // tombstones the first of them is found directly (it is a row number,
+    // or a walk over the chunks of the view); otherwise the live rows before
+    // it are counted one by one.
+    std::vector<std::uint32_t> listedPage(size_t offset, size_t limit) const {
+        std::vector<std::uint32_t> page;
+        size_t start = 0;
+        if (transactions.deletedCount() == 0) {
+            start = offset;
+            offset = 0;
+        }
+
+        auto take = [&](size_t row) {
+            if (transactions.isDeleted(row)) return true;
+            if (offset > 0) {
+                --offset;
+                return true;
+            }
+            page.push_back(static_cast<std::uint32_t>(row));
+            return page.size() < limit;
+        };
+
+        if (listOrder.empty()) {
+            for (size_t i = start; i < transactions.size() && take(i); ++i) {}
+        }
+        else {
+            view(listOrder).forEachFrom(start, take);
+        }
+        return page;
+    }
+
+    // Formats row 'i' as a line of the transaction table, straight into
+    // 'out': id, date, category, amount and description, separated by " | ",
+    // with every field but the description right-aligned to its column.
+    void writeTableRow(BufferedWriter& out, size_t i) const {
+        char buf[32];
+        char* end = std::to_chars(buf, buf + sizeof(buf), transactions.id(i)).ptr;
+        out.appendPadded(std::string_view(buf, end - buf), 3);
+        out.append(" | ");
+
+        end = writeDate(transactions.date(i), buf);
+        out.appendPadded(std::string_view(buf, end - buf), 10);
+        out.append(" | ");
+
+        out.appendPadded(categories.name(transactions.categoryId(i)), 15);
+        out.append(" | ");
+
+        end = writeMoney(transactions.amount(i), buf);
+        out.appendPadded(std::string_view(buf, end - buf), 10);
+        out.append(" | ");
+
+        out.append(transactions.description(i));
+        out.put('\n');
+    }
+
+    // Puts the ledger itself in listing order without tombstones, so that it
+    // matches the file about to be written.
+    void adoptListingOrder() {
+        if (listOrder.empty() && transactions.deletedCount() == 0) return;
+
+        std::vector<size_t> order;
+        order.reserve(transactions.liveCount());
+        forEachListed([&order](size_t row) { order.push_back(row); });
+        transactions.permute(order);
+        rebuildIndexes();
+    }
+
+    // Sets the limit of a category; returns true if a budget already existed.
+    bool applyBudget(std::uint32_t categoryId, Money limit) {
+        for (auto& b : budgets) {
+            if (b.getCategoryId() == categoryId) {
+                b.setLimit(limit);
+                return true;
+            }
+        }
+
+        budgets.push_back(Budget(categoryId, limit));
+        return false;
+    }
+
+    // Tells the user that 'what' only exists in memory because the journal
+    // could not be written.
+    void warnNotJournaled(const std::string& what) const {
+        std::cout << "Warning: could not write to " << journal.getPath() << "; " << what
+                  << " will be lost when the program closes.\n";
+    }
+
+    // Records a change in the journal, warning if that fails.
+    void journalChange(const std::string& record) {
+        if (!journal.append(record)) warnNotJournaled("this change");
+    }
+
+    static std::string budgetRecord(const Budget& b) {
+        std::string record = "B " + formatMoney(b.getLimit());
+        appendField(record, b.getCategory());
+        return record;
+    }
+
+    // Applies one journal record; returns false if it cannot be decoded.
+    bool applyRecord(std::string_view record) {
+        RecordReader in(record);
+        std::string_view type = in.token();
+
+        if (type == "A") {
+            std::uint32_t date;
+            Money amount;
+            std::string_view category, description;
+            if (!validateDate(in.token(), date) || !parseMoney(in.token(), amount) ||
+                !in.field(category) || !in.field(description) || !in.atEnd())
+                return false;
+            applyAdd(Transaction(date, categories.intern(category), amount, std::string(description)));
+        }
+        else if (type == "D") {
+            std::uint64_t id = 0;
+            std::string_view num = in.token();
+            std::from_chars_result r = std::from_chars(num.data(), num.data() + num.size(), id);
+            if (num.empty() || r.ec != std::errc() || r.ptr != num.data() + num.size() ||
+                !in.atEnd() || !applyDelete(id))
+                return false;
+        }
+        else if (type == "X") {
+            TransactionFilter filter;
+            std::string_view from = in.token(), to = in.token(), min = in.token(), max = in.token();
+            std::string_view flag = in.token();
+            std::string_view category, description;
+            auto number = [](std::string_view text, auto& value) {
+                std::from_chars_result r = std::from_chars(text.data(), text.data() + text.size(), value);
+                return !text.empty() && r.ec == std::errc() && r.ptr == text.data() + text.size();
+            };
+            if (!number(from, filter.fromDate) || !number(to, filter.toDate) ||
+                !number(min, filter.minAmount) || !number(max, filter.maxAmount) ||
+                (flag != "C" && flag != "-") || !in.field(category) || !in.field(description) || !in.atEnd())
+                return false;
+            filter.byCategory = flag == "C";
+            filter.category = std::string(category);
+            filter.descriptionContains = std::string(description);
+            applyDeleteMatching(filter);
+        }
+        else if (type == "S") {
+            SortOrder order;
+            if (!parseOrderCode(in.token(), order) || !in.atEnd())
+                return false;
+            applyOrder(order);
+        }
+        else if (type == "B") {
+            Money limit;
+            std::string_view category;
+            if (!parseMoney(in.token(), limit) || !in.field(category) || !in.atEnd())
+                return false;
+            applyBudget(categories.intern(category), limit);
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    // Makes 'filename' the current ledger file and replays the changes its
+    // journal recorded on top of what was just loaded. 'stamp' identifies
+    // the contents that were loaded (see snapshotStamp).
+    void attachJournal(const std::string& filename, const std::string& stamp) {
+        journal.attach(filename, stamp);
+
+        MappedFile log(journal.getPath());
+        if (!log.isOpen() || log.contents().empty()) return;
+
+        std::string_view data = log.contents();
+        size_t nl = data.find('\n');
+        if (nl == std::string_view::npos || data.substr(0, nl) != stamp) {
+            std::cout << "Ignoring " << journal.getPath() << " (it belongs to an older save).\n";
+            journal.discard();
+            return;
+        }
+        data.remove_prefix(nl + 1);
+
+        int applied = 0, damaged = 0;
+        while (!data.empty()) {
+            nl = data.find('\n');
+            if (nl == std::string_view::npos) { // Cut short by a crash.
+                journal.markTornTail();
+                damaged++;
+                break;
+            }
+            if (applyRecord(data.substr(0, nl))) applied++;
+            else damaged++;
+            data.remove_prefix(nl + 1);
+        }
+
+        if (applied > 0)
+            std::cout << "Replayed " << applied << " changes from " << journal.getPath() << ".\n";
+        if (damaged > 0)
+            std::cout << "Skipped " << damaged << " damaged entries in " << journal.getPath() << ".\n";
+    }
+
+public:
+    FinanceManager() {}
+
+    // Opens the ledger used at startup: of the CSV file and the binary
+    // snapshot, the one changed last (saved, or extended by its journal),
+    // with its journal replayed. The snapshot wins a tie, as it loads
+    // faster; the CSV file is the fallback if the snapshot cannot be read.
+    void openLedger(const std::string& csvName, const std::string& snapshotName) {
+        std::filesystem::file_time_type csvTime, snapshotTime;
+        bool haveCsv = lastChanged(csvName, csvTime);
+        bool haveSnapshot = lastChanged(snapshotName, snapshotTime);
+
+        if (haveSnapshot && (!haveCsv || snapshotTime >= csvTime)) {
+            std::error_code ec;
+            if (!std::filesystem::exists(snapshotName, ec)) {
+                attachJournal(snapshotName, snapshotStamp(std::string_view()));
+                return;
+            }
+            if (loadSnapshot(snapshotName)) return;
+        }
+
+        std::error_code ec;
+        if (std::filesystem::exists(csvName, ec))
+            loadFromFile(csvName);
+        else
+            attachJournal(csvName, snapshotStamp(std::string_view()));
+    }
+
+    // Returns the number of transactions.
+    size_t getSize() const {
+        return transactions.liveCount();
+    }
+
+    // Adds a new transaction.
+    void addTransaction(const Transaction& t) {
+        Money before = spentOn(t.getCategoryId());
+        applyAdd(t);
+
+        std::string record = "A " + formatDate(t.getDate()) + " " + formatMoney(t.getAmount());
+        appendField(record, t.getCategory());
+        appendField(record, t.getDescription());
+        journalChange(record);
+
+        std::cout << "Transaction added successfully.\n";
+
+        if (t.getAmount() < 0) {
+            // Warn as soon as this expense pushes its category over budget.
+            for (const auto& b : budgets) {
+                if (b.getCategoryId() == t.getCategoryId() &&
+                    before <= b.getLimit() && spentOn(b.getCategoryId()) > b.getLimit()) {
+                    std::cout << "ALERT! Category '" << b.getCategory()
+                        << "' has exceeded the budget! Spent: $"
+                        << formatMoney(spentOn(b.getCategoryId())) << ", Limit: $" << formatMoney(b.getLimit()) << "\n";
+                }
+            }
+        }
+    }
+
+    // Removes every transaction matching 'filter' in one pass: matching rows
+    // are marked, then compacted away together and the indexes are rebuilt
+    // once. Returns the number of transactions removed.
+    size_t deleteMatching(const TransactionFilter& filter) {
+        size_t removed = applyDeleteMatching(filter);
+        if (removed == 0) {
+            std::cout << "No transactions match.\n";
+            return 0;
+        }
+
+        std::string record = "X " + std::to_string(filter.fromDate) + " " + std::to_string(filter.toDate) +
+            " " + std::to_string(filter.minAmount) + " " + std::to_string(filter.maxAmount) +
+            (filter.byCategory ? " C" : " -");
+        appendField(record, filter.category);
+        appendField(record, filter.descriptionContains);
+        journalChange(record);
+
+        std::cout << "Deleted " << removed << " transactions.\n";
+        return removed;
     }
 
-    // Removes a transaction by index.
-    bool deleteTransaction(int index) {
-        if (index < 0 || index >= static_cast<int>(transactions.size()))
+    // Removes a transaction by its id.
+    bool deleteTransaction(std::uint64_t id) {
+        if (!applyDelete(id))
             return false;
 
-        transactions.erase(transactions.begin() + index);
+        journalChange("D " + std::to_string(id));
         std::cout << "Transaction deleted successfully.\n";
         return true;
     }
 
-    // Displays all recorded transactions.
+    // Displays the transactions in listing order, one page at a time. Only
+    // the rows of the page shown are visited, and they are formatted into a
+    // single buffer, so a page appears at once whatever the ledger size.
     void listTransactions() const {
         if (transactions.empty()) {
             std::cout << "No transactions recorded.\n";
             return;
         }
 
-        std::cout << "Idx | Date        | Category       |    Amount | Description\n";
-        std::cout << "-------------------------------------------------------------------\n";
+        const size_t pageRows = 20;
+        size_t pages = (transactions.liveCount() + pageRows - 1) / pageRows;
+        size_t page = 0;
+
+        while (true) {
+            std::cout << " ID | Date        | Category       |    Amount | Description\n";
+            std::cout << "-------------------------------------------------------------------\n";
+            std::cout.flush();
+            {
+                BufferedWriter out(stdout, 1 << 16);
+                for (std::uint32_t i : listedPage(page * pageRows, pageRows)) writeTableRow(out, i);
+            }
+            std::fflush(stdout);
 
-        for (size_t i = 0; i < transactions.size(); ++i) {
-            std::cout << std::setw(3) << i << " | " << transactions[i].toString() << "\n";
+            if (pages == 1) return;
+
+            std::cout << "Page " << page + 1 << " of " << pages
+                      << " (n = next, p = previous, a number = that page, ENTER = done): ";
+            std::string choice;
+            if (!std::getline(std::cin, choice)) return;
+            std::string_view c = trimView(choice);
+
+            if (c.empty()) return;
+            if (c == "n" || c == "N") {
+                if (page + 1 < pages) ++page;
+            }
+            else if (c == "p" || c == "P") {
+                if (page > 0) --page;
+            }
+            else {
+                size_t n = 0;
+                std::from_chars_result r = std::from_chars(c.data(), c.data() + c.size(), n);
+                if (r.ec != std::errc() || r.ptr != c.data() + c.size() || n == 0 || n > pages) {
+                    std::cout << "Invalid choice.\n";
+                    continue;
+                }
+                page = n - 1;
+            }
         }
     }
 
     // Writes all transactions into a CSV file.
-    void saveToFile(const std::string& filename) const {
-        std::ofstream file(filename);
-
-        if (!file) {
+    // Rows are formatted straight into a BufferedWriter, which hands the
+    // file large blocks. The file is replaced atomically (see AtomicFile);
+    // 'syncDirectory' also makes the rename durable. Afterwards the saved
+    // file becomes the current ledger and its journal starts empty; rows and
+    // ids are renumbered to match what loading the file gives.
+    void saveToFile(const std::string& filename, bool syncDirectory = false) {
+        AtomicFile file(filename);
+
+        if (!file.isOpen()) {
             std::cout << "Error opening file to save.\n";
             return;
         }
 
-        for (const auto& t : transactions) {
-            std::string desc = t.getDescription();
-            std::replace(desc.begin(), desc.end(), ',', ';'); // Prevent CSV break
+        adoptListingOrder();
+
+        ByteHasher written;
+        {
+            BufferedWriter out(file.handle());
+            out.hashInto(written);
+
+            for (size_t i = 0; i < transactions.size(); ++i) {
+                if (transactions.isDeleted(i)) continue;
+
+                char* p = out.reserve(64); // Date, amount and separators fit in 64 bytes
+                p = writeDate(transactions.date(i), p);
+                *p++ = ',';
+                out.commit(p);
+
+                out.append(categories.name(transactions.categoryId(i)), ',', ';'); // Prevent CSV break
+
+                p = out.reserve(64);
+                *p++ = ',';
+                p = writeMoney(transactions.amount(i), p);
+                *p++ = ',';
+                out.commit(p);
 
-            file << t.getDate() << ","
-                << t.getCategory() << ","
-                << t.getAmount() << ","
-                << desc << "\n";
+                out.append(transactions.description(i), ',', ';'); // Prevent CSV break
+                out.put('\n');
+            }
+        }
+
+        AtomicFile::Result result = file.commit(syncDirectory);
+        if (result == AtomicFile::FAILED) {
+            std::cout << "Error writing to file.\n";
+            return;
         }
 
-        file.close();
+        // The file has been replaced even if the directory sync failed, so
+        // it becomes the current ledger either way.
+        bool renumbered = transactions.renumberIds();
+
+        // Budgets and the listing order are not part of the CSV, so they
+        // start the new journal.
+        journal.attach(filename, snapshotStamp(written));
+        journal.discard();
+        bool journaled = true;
+        for (const auto& b : budgets)
+            journaled = journal.append(budgetRecord(b)) && journaled;
+        if (!listOrder.empty())
+            journaled = journal.append("S " + orderCode(listOrder)) && journaled;
+
         std::cout << "Data saved to " << filename << "\n";
+        if (renumbered)
+            std::cout << "Note: transaction IDs were renumbered 1-" << transactions.size()
+                      << " to follow the order of the file.\n";
+        if (!journaled) warnNotJournaled("the budgets and the listing order");
+        if (result == AtomicFile::DIRECTORY_NOT_SYNCED)
+            std::cout << "Warning: the folder could not be synced, so a power loss may still undo this save.\n";
     }
 
-    // Loads transactions from a CSV file.
-    void loadFromFile(const std::string& filename) {
-        std::ifstream file(filename);
+    // Writes transactions (with their ids), budgets and category names into
+    // a binary snapshot (see SnapshotHeader), replacing the file atomically.
+    // Afterwards the snapshot becomes the current ledger with an empty journal.
+    void saveSnapshot(const std::string& filename, bool syncDirectory = false) {
+        AtomicFile file(filename);
 
-        if (!file) {
-            std::cout << "Error opening file to load.\n";
+        if (!file.isOpen()) {
+            std::cout << "Error opening file to save.\n";
             return;
         }
 
-        transactions.clear();
-        std::string line;
-        int lineCount = 0;
+        std::vector<std::uint64_t> categoryEnds;
+        std::string categoryPool;
+        for (std::uint32_t id = 0; id < categories.size(); ++id) {
+            categoryPool += categories.name(id);
+            categoryEnds.push_back(categoryPool.size());
+        }
 
-        while (getline(file, line)) {
-            lineCount++;
-            std::stringstream ss(line);
+        // The format has no tombstones and no listing order.
+        adoptListingOrder();
 
-            std::string date, category, amountStr, description;
+        std::vector<Money> budgetLimits;
+        std::vector<std::uint32_t> budgetCategories;
+        for (const auto& b : budgets) {
+            budgetLimits.push_back(b.getLimit());
+            budgetCategories.push_back(b.getCategoryId());
+        }
+
+        SnapshotHeader header = {};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER;
+        header.rows = transactions.size();
+        header.categoryCount = categoryEnds.size();
+        header.budgetCount = budgets.size();
+        header.categoryPoolBytes = categoryPool.size();
+        header.descriptionPoolBytes = transactions.descriptionPool().size();
+        header.nextId = transactions.highestId() + 1; // See trimNextId
+
+        ByteHasher written;
+        {
+            BufferedWriter out(file.handle());
+            out.hashInto(written);
+            size_t rows = transactions.size();
+
+            writeColumn(out, &header, 1);
+            writeColumn(out, transactions.amountColumn().data(), rows);
+            writeColumn(out, transactions.descOffsetColumn().data(), rows);
+            writeColumn(out, transactions.idColumn().data(), rows);
+            writeColumn(out, categoryEnds.data(), categoryEnds.size());
+            writeColumn(out, budgetLimits.data(), budgetLimits.size());
+            writeColumn(out, transactions.dateColumn().data(), rows);
+            writeColumn(out, transactions.categoryColumn().data(), rows);
+            writeColumn(out, transactions.descLengthColumn().data(), rows);
+            writeColumn(out, budgetCategories.data(), budgetCategories.size());
+            out.append(categoryPool);
+            out.append(transactions.descriptionPool());
+        }
 
-            getline(ss, date, ',');
-            getline(ss, category, ',');
-            getline(ss, amountStr, ',');
-            getline(ss, description);
+        AtomicFile::Result result = file.commit(syncDirectory);
+        if (result == AtomicFile::FAILED) {
+            std::cout << "Error writing to file.\n";
+            return;
+        }
 
-            date = trim(date);
-            category = trim(category);
-            amountStr = trim(amountStr);
-            description = trim(description);
+        // Rows added from now on must get the ids that replaying the journal
+        // on top of the snapshot gives them.
+        transactions.trimNextId();
 
-            if (!validateDate(date)) {
-                std::cout << "Invalid date format on line " << lineCount << ". Skipping.\n";
-                continue;
+        journal.attach(filename, snapshotStamp(written));
+        journal.discard();
+        bool journaled = listOrder.empty() || journal.append("S " + orderCode(listOrder));
+
+        std::cout << "Snapshot saved to " << filename << "\n";
+        if (!journaled) warnNotJournaled("the listing order");
+        if (result == AtomicFile::DIRECTORY_NOT_SYNCED)
+            std::cout << "Warning: the folder could not be synced, so a power loss may still undo this save.\n";
+    }
+
+    // Loads a binary snapshot written by saveSnapshot. The file is mapped and
+    // each column is copied in one piece; only category ids are translated
+    // if this run's dictionary numbers the names differently. Returns false
+    // if nothing was loaded.
+    bool loadSnapshot(const std::string& filename) {
+        MappedFile file(filename);
+
+        if (!file.isOpen()) {
+            std::cout << "Error opening file to load.\n";
+            return false;
+        }
+
+        std::string_view data = file.contents();
+        SnapshotHeader header;
+
+        if (data.size() < sizeof(header)) {
+            std::cout << "Not a snapshot file.\n";
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+            header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+            std::cout << "Not a snapshot file.\n";
+            return false;
+        }
+        if (header.version != SNAPSHOT_VERSION) {
+            std::cout << "Unsupported snapshot version " << header.version << ".\n";
+            return false;
+        }
+
+        // Every section size must add up to the file size exactly.
+        const std::uint64_t limit = data.size();
+        std::uint64_t rows = header.rows, cats = header.categoryCount, nBudgets = header.budgetCount;
+        if (rows > limit || cats > limit || nBudgets > limit ||
+            header.categoryPoolBytes > limit || header.descriptionPoolBytes > limit ||
+            header.nextId <= rows || header.nextId > 0xFFFFFFFF ||
+            sizeof(header) + rows * 36 + cats * 8 + nBudgets * 12 +
+            header.categoryPoolBytes + header.descriptionPoolBytes != limit) {
+            std::cout << "Snapshot file is damaged.\n";
+            return false;
+        }
+
+        const char* p = data.data() + sizeof(header);
+        auto column = [&p](std::uint64_t count, size_t width) {
+            const char* start = p;
+            p += count * width;
+            return start;
+        };
+        const Money* amounts = reinterpret_cast<const Money*>(column(rows, 8));
+        const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(column(rows, 8));
+        const std::uint64_t* ids = reinterpret_cast<const std::uint64_t*>(column(rows, 8));
+        const std::uint64_t* categoryEnds = reinterpret_cast<const std::uint64_t*>(column(cats, 8));
+        const Money* budgetLimits = reinterpret_cast<const Money*>(column(nBudgets, 8));
+        const std::uint32_t* dates = reinterpret_cast<const std::uint32_t*>(column(rows, 4));
+        const std::uint32_t* categoryIds = reinterpret_cast<const std::uint32_t*>(column(rows, 4));
+        const std::uint32_t* lengths = reinterpret_cast<const std::uint32_t*>(column(rows, 4));
+        const std::uint32_t* budgetCategories = reinterpret_cast<const std::uint32_t*>(column(nBudgets, 4));
+        std::string_view categoryPool(column(header.categoryPoolBytes, 1), header.categoryPoolBytes);
+        std::string_view descriptionPool(column(header.descriptionPoolBytes, 1), header.descriptionPoolBytes);
+
+        // Validate references before trusting them.
+        for (std::uint64_t i = 0; i < cats; ++i) {
+            if (categoryEnds[i] > categoryPool.size() || (i > 0 && categoryEnds[i] < categoryEnds[i - 1])) {
+                std::cout << "Snapshot file is damaged.\n";
+                return false;
+            }
+        }
+        for (std::uint64_t i = 0; i < rows; ++i) {
+            if (categoryIds[i] >= cats || offsets[i] > descriptionPool.size() ||
+                lengths[i] > descriptionPool.size() - offsets[i]) {
+                std::cout << "Snapshot file is damaged.\n";
+                return false;
+            }
+        }
+        for (std::uint64_t i = 0; i < nBudgets; ++i) {
+            if (budgetCategories[i] >= cats) {
+                std::cout << "Snapshot file is damaged.\n";
+                return false;
+            }
+        }
+        std::vector<std::uint64_t> sortedIds(ids, ids + rows);
+        std::sort(sortedIds.begin(), sortedIds.end());
+        // nextId sizes the id table, so it must follow from the ids stored.
+        if ((rows > 0 && (sortedIds.front() == 0 ||
+            std::adjacent_find(sortedIds.begin(), sortedIds.end()) != sortedIds.end())) ||
+            header.nextId != (rows > 0 ? sortedIds.back() + 1 : 1)) {
+            std::cout << "Snapshot file is damaged.\n";
+            return false;
+        }
+
+        // The ids themselves may still be too large to index; load into a
+        // new store so that the current ledger survives a failure.
+        TransactionStore loaded;
+        try {
+            loaded.assign(rows, dates, categoryIds, amounts, offsets, lengths, descriptionPool, ids, header.nextId);
+        }
+        catch (const std::bad_alloc&) {
+            std::cout << "Snapshot file is damaged.\n";
+            return false;
+        }
+
+        std::vector<std::uint32_t> globalId(cats);
+        bool sameIds = true;
+        for (std::uint64_t i = 0; i < cats; ++i) {
+            std::uint64_t start = i == 0 ? 0 : categoryEnds[i - 1];
+            globalId[i] = categories.intern(categoryPool.substr(start, categoryEnds[i] - start));
+            sameIds = sameIds && globalId[i] == i;
+        }
+
+        transactions = std::move(loaded);
+        if (!sameIds) transactions.remapCategories(globalId);
+
+        budgets.clear();
+        for (std::uint64_t i = 0; i < nBudgets; ++i)
+            budgets.push_back(Budget(globalId[budgetCategories[i]], budgetLimits[i]));
+
+        // The listing order is kept in the journal, like every change since
+        // the save; none carries over from the previous ledger.
+        listOrder.clear();
+        rebuildIndexes();
+        std::cout << "Snapshot loaded with " << transactions.size() << " transactions.\n";
+
+        attachJournal(filename, snapshotStamp(data));
+        return true;
+    }
+
+    // Loads transactions from a CSV file.
+    // The file is memory-mapped and every field is parsed as a view over the
+    // mapping; strings are only allocated for the rows that are kept.
+    // Large files are split into newline-aligned ranges that are parsed on
+    // 'threads' workers (0 = one per core) and spliced back in file order.
+    void loadFromFile(const std::string& filename, unsigned threads = 0) {
+        MappedFile file(filename);
+
+        if (!file.isOpen()) {
+            std::cout << "Error opening file to load.\n";
+            return;
+        }
+
+        std::string_view data = file.contents();
+
+        // Small files are not worth the thread start-up cost.
+        const size_t minBytesPerThread = 1 << 20;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(threads, data.size() / minBytesPerThread + 1));
+
+        // Cut the file at the first newline after each even split point.
+        std::vector<std::string_view> ranges;
+        size_t begin = 0;
+        for (unsigned i = 1; i <= threads && begin < data.size(); ++i) {
+            size_t end = data.size();
+            if (i < threads) {
+                end = std::max(begin, data.size() / threads * i);
+                end = data.find('\n', end);
+                end = (end == std::string_view::npos) ? data.size() : end + 1;
             }
+            ranges.push_back(data.substr(begin, end - begin));
+            begin = end;
+        }
 
-            if (!isNumber(amountStr)) {
-                std::cout << "Invalid amount on line " << lineCount << ". Skipping.\n";
-                continue;
+        // The stamp that identifies the file to its journal is worked out
+        // while the file is mapped anyway.
+        std::string stamp;
+        std::vector<CsvChunk> chunks(ranges.size());
+        if (ranges.size() == 1) {
+            parseCsvChunk(ranges[0], chunks[0], categories);
+            stamp = snapshotStamp(data);
+        }
+        else {
+            // Workers intern into their own dictionaries; the ids are
+            // translated to global ones below, so no locking is needed.
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < ranges.size(); ++i)
+                workers.emplace_back(parseCsvChunk, ranges[i], std::ref(chunks[i]),
+                    std::ref(chunks[i].localCategories));
+            stamp = snapshotStamp(data); // While the workers parse
+            for (auto& w : workers) w.join();
+
+            for (auto& c : chunks) {
+                std::vector<std::uint32_t> globalId(c.localCategories.size());
+                for (std::uint32_t id = 0; id < globalId.size(); ++id)
+                    globalId[id] = categories.intern(c.localCategories.name(id));
+
+                c.rows.remapCategories(globalId);
             }
+        }
 
-            double amount = stod(amountStr);
+        transactions.clear();
+        if (chunks.size() == 1) {
+            transactions = std::move(chunks[0].rows);
+        }
+        else {
+            size_t total = 0;
+            for (const auto& c : chunks) total += c.rows.size();
+            transactions.reserve(total, data.size());
+        }
+        int lineOffset = 0;
+
+        for (auto& c : chunks) {
+            for (const auto& e : c.errors) {
+                if (e.second)
+                    std::cout << "Invalid date format on line " << lineOffset + e.first << ". Skipping.\n";
+                else
+                    std::cout << "Invalid amount on line " << lineOffset + e.first << ". Skipping.\n";
+            }
 
-            transactions.push_back(Transaction(date, category, amount, description));
+            if (chunks.size() > 1) transactions.append(c.rows);
+            lineOffset += c.lineCount;
         }
 
-        file.close();
+        // Budgets and the listing order of a CSV ledger are kept in its
+        // journal (see saveToFile); none carry over from the previous ledger.
+        budgets.clear();
+        listOrder.clear();
+        rebuildIndexes();
         std::cout << "File loaded with " << transactions.size() << " transactions.\n";
+
+        attachJournal(filename, stamp);
     }
 
     // Prints a summary of income, expenses and net balance for a specific month.
@@ -299,25 +2803,197 @@ public:
             return;
         }
 
-        double income = 0, expense = 0;
+        // Packed YYYYMM; a month with non-digits matches no transaction.
+        std::uint32_t month = 0;
+        for (size_t i = 0; i < yearMonth.size(); ++i) {
+            if (i == 4) continue;
+            if (!isdigit(static_cast<unsigned char>(yearMonth[i]))) { month = 0; break; }
+            month = month * 10 + (yearMonth[i] - '0');
+        }
+
+        Money income = 0, expense = 0;
 
-        // Loop through all transactions of the specified month.
-        for (const auto& t : transactions) {
-            if (t.getDate().substr(0, 7) == yearMonth) {
-                if (t.getAmount() >= 0) income += t.getAmount();
-                else expense += t.getAmount();
-            }
+        const MonthBucket* bucket = months.find(month);
+        if (bucket) {
+            income = bucket->income;
+            expense = bucket->expense;
         }
 
         std::cout << "\nSummary for " << yearMonth << ":\n";
-        std::cout << "Income:   $" << std::fixed << std::setprecision(2) << income << "\n";
-        std::cout << "Expenses: $" << std::fixed << std::setprecision(2) << expense << "\n";
-        std::cout << "Net:      $" << std::fixed << std::setprecision(2) << (income + expense) << "\n";
+        printTotals(income, expense);
+    }
+
+    // Summary lines shared by the monthly and the date-range reports.
+    static void printTotals(Money income, Money expense) {
+        std::cout << "Income:   $" << formatMoney(income) << "\n";
+        std::cout << "Expenses: $" << formatMoney(expense) << "\n";
+        std::cout << "Net:      $" << formatMoney(income + expense) << "\n";
+    }
+
+    // Builds the text indexes that the leaves of 'q' could use. They are
+    // only built for interactive searches, which are likely to be repeated;
+    // for a one-off pass (like a bulk delete) a scan is cheaper than a build.
+    void prepareIndexes(const Query& q) const {
+        if (q.kind == Query::TEXT && q.text.size() >= TrigramIndex::MIN_QUERY && !byTrigram.isBuilt())
+            byTrigram.build(transactions);
+        if (q.kind == Query::WORDS && !byWord.isBuilt())
+            byWord.build(transactions);
+        for (const Query& c : q.children) prepareIndexes(c);
+    }
+
+    // Upper bound on the number of rows the indexes would offer for 'q';
+    // transactions.size() when no index helps (including a text index that
+    // has not been built).
+    size_t estimateRows(const Query& q) const {
+        size_t all = transactions.size();
+        switch (q.kind) {
+        case Query::DATE_RANGE:
+            return byDate.count(q.fromDate, q.toDate);
+        case Query::CATEGORIES: {
+            size_t n = 0;
+            for (std::uint32_t id : q.categoryIds) n += byCategory.rows(id).size();
+            return n;
+        }
+        case Query::TEXT:
+            if (q.text.size() < TrigramIndex::MIN_QUERY || !byTrigram.isBuilt()) return all;
+            return std::min(all, byTrigram.estimate(q.text));
+        case Query::WORDS: {
+            if (q.words.empty()) return 0;
+            if (!byWord.isBuilt()) return all;
+            size_t n = all;
+            for (const std::string& w : q.words) n = std::min(n, byWord.countWithPrefix(w));
+            return n;
+        }
+        case Query::AND: {
+            size_t n = all;
+            for (const Query& c : q.children) n = std::min(n, estimateRows(c));
+            return n;
+        }
+        case Query::OR: {
+            size_t n = 0;
+            for (const Query& c : q.children) n += estimateRows(c);
+            return std::min(n, all);
+        }
+        default:
+            return all;
+        }
+    }
+
+    // Rows offered by the indexes for 'q': ascending, a superset of the live
+    // matches, possibly with tombstones. An AND starts from its most
+    // selective child only; the other conditions are left to forEachMatch.
+    std::vector<std::uint32_t> candidateRows(const Query& q) const {
+        std::vector<std::uint32_t> rows;
+        switch (q.kind) {
+        case Query::DATE_RANGE:
+            byDate.forEachInRange(q.fromDate, q.toDate, [&rows](size_t row) {
+                rows.push_back(static_cast<std::uint32_t>(row));
+            });
+            std::sort(rows.begin(), rows.end());
+            return rows;
+        case Query::CATEGORIES:
+            for (std::uint32_t id : q.categoryIds) {
+                const std::vector<std::uint32_t>& list = byCategory.rows(id);
+                rows.insert(rows.end(), list.begin(), list.end());
+            }
+            if (q.categoryIds.size() > 1) std::sort(rows.begin(), rows.end());
+            return rows;
+        case Query::TEXT:
+            if (q.text.size() < TrigramIndex::MIN_QUERY || !byTrigram.isBuilt()) break;
+            return byTrigram.candidates(q.text);
+        case Query::WORDS: {
+            if (!byWord.isBuilt()) break;
+            std::vector<std::vector<std::uint32_t>> lists;
+            for (const std::string& w : q.words) lists.push_back(byWord.rowsWithPrefix(w));
+            if (lists.empty()) return rows;
+            std::sort(lists.begin(), lists.end(),
+                      [](const std::vector<std::uint32_t>& a, const std::vector<std::uint32_t>& b) {
+                          return a.size() < b.size();
+                      });
+            rows = std::move(lists[0]);
+            for (size_t i = 1; i < lists.size() && !rows.empty(); ++i) {
+                std::vector<std::uint32_t> both;
+                std::set_intersection(rows.begin(), rows.end(), lists[i].begin(), lists[i].end(),
+                                      std::back_inserter(both));
+                rows.swap(both);
+            }
+            return rows;
+        }
+        case Query::AND: {
+            const Query* best = nullptr;
+            size_t bestRows = 0;
+            for (const Query& c : q.children) {
+                size_t n = estimateRows(c);
+                if (!best || n < bestRows) { best = &c; bestRows = n; }
+            }
+            if (best) return candidateRows(*best);
+            break;
+        }
+        case Query::OR:
+            for (const Query& c : q.children) {
+                std::vector<std::uint32_t> more = candidateRows(c), both;
+                std::set_union(rows.begin(), rows.end(), more.begin(), more.end(), std::back_inserter(both));
+                rows.swap(both);
+            }
+            return rows;
+        default:
+            break;
+        }
+
+        rows.resize(transactions.size());
+        for (size_t i = 0; i < rows.size(); ++i) rows[i] = static_cast<std::uint32_t>(i);
+        return rows;
+    }
+
+    // Calls f(row) for every live row matching 'q', in ledger order. The
+    // most selective index narrows the rows first, and the full condition is
+    // then checked on those rows only; without a useful index, every row is
+    // checked.
+    template <typename F>
+    void forEachMatch(const Query& q, F f) const {
+        if (estimateRows(q) >= transactions.size()) {
+            for (size_t i = 0; i < transactions.size(); ++i) {
+                if (!transactions.isDeleted(i) && q.matches(transactions, i)) f(i);
+            }
+            return;
+        }
+        for (std::uint32_t row : candidateRows(q)) {
+            if (!transactions.isDeleted(row) && q.matches(transactions, row)) f(row);
+        }
+    }
+
+    std::vector<std::uint32_t> findRows(const Query& q) const {
+        std::vector<std::uint32_t> rows;
+        forEachMatch(q, [&rows](size_t row) { rows.push_back(static_cast<std::uint32_t>(row)); });
+        return rows;
+    }
+
+    // Prints search results; returns false if there are none.
+    bool printResults(const std::vector<std::uint32_t>& rows) const {
+        if (rows.empty()) return false;
+
+        std::cout << "Results found:\n";
+        std::cout << " ID | Date        | Category       |    Amount | Description\n";
+        std::cout << "-------------------------------------------------------------------\n";
+
+        std::cout.flush();
+        {
+            BufferedWriter out(stdout);
+            for (std::uint32_t i : rows) writeTableRow(out, i);
+        }
+        std::fflush(stdout);
+        return true;
+    }
+
+    // Rows matching an interactive search, building any text index it needs.
+    std::vector<std::uint32_t> search(const Query& q) const {
+        prepareIndexes(q);
+        return findRows(q);
     }
 
-    // Searches transactions either by category or exact date.
+    // Searches transactions by category, date, amount or text.
     void searchTransactions() const {
-        std::cout << "Search by:\n1. Category (substring)\n2. Exact date (YYYY-MM-DD)\nOption: ";
+        std::cout << "Search by:\n1. Category (substring)\n2. Exact date (YYYY-MM-DD)\n3. Category (exact)\n4. Date range\n5. Description words\n6. Any text (category or description)\n7. Several conditions\nOption: ";
         std::string optStr;
         std::getline(std::cin, optStr);
 
@@ -330,60 +3006,105 @@ public:
             std::string query;
             std::getline(std::cin, query);
 
-            bool found = false;
+            if (!printResults(search(Query::categoryNameContains(query))))
+                std::cout << "No transactions found for that category.\n";
+        }
+        else if (opt == 3) {
+            std::cout << "Enter the exact category: ";
+            std::string query;
+            std::getline(std::cin, query);
 
-            for (size_t i = 0; i < transactions.size(); ++i) {
-                if (transactions[i].getCategory().find(query) != std::string::npos) {
-                    if (!found) {
-                        std::cout << "Results found:\n";
-                        std::cout << "Idx | Date        | Category       |    Amount | Description\n";
-                        std::cout << "-------------------------------------------------------------------\n";
-                    }
-
-                    std::cout << std::setw(3) << i << " | " << transactions[i].toString() << "\n";
-                    found = true;
-                }
-            }
+            TransactionFilter filter;
+            filter.byCategory = true;
+            filter.category = trim(query);
 
-            if (!found)
+            if (!printResults(search(Query::fromFilter(filter))))
                 std::cout << "No transactions found for that category.\n";
         }
         else if (opt == 2) {
             std::cout << "Enter exact date (YYYY-MM-DD): ";
-            std::string date;
-            std::getline(std::cin, date);
+            std::string dateStr;
+            std::getline(std::cin, dateStr);
 
-            if (!validateDate(date)) {
+            std::uint32_t date;
+            if (!validateDate(dateStr, date)) {
                 std::cout << "Invalid date.\n";
                 return;
             }
 
-            bool found = false;
+            if (!printResults(search(Query::dateRange(date, date))))
+                std::cout << "No transactions found on that date.\n";
+        }
+        else if (opt == 4) {
+            std::uint32_t from, to;
+            std::string dateStr;
 
-            for (size_t i = 0; i < transactions.size(); ++i) {
-                if (transactions[i].getDate() == date) {
-                    if (!found) {
-                        std::cout << "Results found:\n";
-                        std::cout << "Idx | Date        | Category       |    Amount | Description\n";
-                        std::cout << "-------------------------------------------------------------------\n";
-                    }
-
-                    std::cout << std::setw(3) << i << " | " << transactions[i].toString() << "\n";
-                    found = true;
-                }
+            std::cout << "From date (YYYY-MM-DD): ";
+            std::getline(std::cin, dateStr);
+            if (!validateDate(dateStr, from)) {
+                std::cout << "Invalid date.\n";
+                return;
             }
 
-            if (!found)
-                std::cout << "No transactions found on that date.\n";
+            std::cout << "To date (YYYY-MM-DD): ";
+            std::getline(std::cin, dateStr);
+            if (!validateDate(dateStr, to)) {
+                std::cout << "Invalid date.\n";
+                return;
+            }
+
+            // Listed in date order, like a statement.
+            std::vector<std::uint32_t> rows = search(Query::dateRange(from, to));
+            std::stable_sort(rows.begin(), rows.end(), [this](std::uint32_t a, std::uint32_t b) {
+                return transactions.date(a) < transactions.date(b);
+            });
+            if (!printResults(rows)) {
+                std::cout << "No transactions found in that period.\n";
+                return;
+            }
+
+            Money income = 0, expense = 0;
+            for (std::uint32_t i : rows) {
+                if (transactions.amount(i) >= 0) income += transactions.amount(i);
+                else expense += transactions.amount(i);
+            }
+            printTotals(income, expense);
+        }
+        else if (opt == 5) {
+            std::cout << "Enter words (or word beginnings) to find: ";
+            std::string query;
+            std::getline(std::cin, query);
+
+            if (!printResults(search(Query::descriptionWords(query))))
+                std::cout << "No transactions found with that text.\n";
+        }
+        else if (opt == 6) {
+            std::cout << "Enter the text to find: ";
+            std::string query;
+            std::getline(std::cin, query);
+
+            Query q = Query::anyOf({ Query::categoryNameContains(query), Query::descriptionContains(query) });
+            if (query.empty() || !printResults(search(q)))
+                std::cout << "No transactions found with that text.\n";
+        }
+        else if (opt == 7) {
+            TransactionFilter filter = inputFilter();
+
+            std::cout << "Match 1. all conditions or 2. any condition? ";
+            std::string modeStr;
+            std::getline(std::cin, modeStr);
+
+            if (!printResults(search(Query::fromFilter(filter, trimView(modeStr) == "2"))))
+                std::cout << "No transactions match.\n";
         }
         else {
             std::cout << "Invalid option.\n";
         }
     }
 
-    // Sorts transactions by date or by amount.
+    // Chooses the order of listings and saved files.
     void sortTransactions() {
-        std::cout << "Sort by:\n1. Date ascending\n2. Amount ascending\nOption: ";
+        std::cout << "Sort by:\n1. Date ascending\n2. Amount ascending\n3. Category (A-Z)\n4. Order of entry\n5. Several fields\nOption: ";
         std::string optStr;
         std::getline(std::cin, optStr);
 
@@ -391,23 +3112,56 @@ public:
         try { opt = std::stoi(optStr); }
         catch (...) { std::cout << "Invalid option.\n"; return; }
 
-        if (opt == 1) {
-            std::sort(transactions.begin(), transactions.end(),
-                [](const Transaction& a, const Transaction& b) {
-                    return a.getDate() < b.getDate();
-                });
-            std::cout << "Transactions sorted by date ascending.\n";
+        SortOrder order;
+        if (opt >= 1 && opt <= 4) {
+            parseOrderCode(std::to_string(opt), order);
         }
-        else if (opt == 2) {
-            std::sort(transactions.begin(), transactions.end(),
-                [](const Transaction& a, const Transaction& b) {
-                    return a.getAmount() < b.getAmount();
-                });
-            std::cout << "Transactions sorted by amount ascending.\n";
+        else if (opt == 5) {
+            std::cout << "Fields in order (date, amount, category; add '-' for descending,\n"
+                         "e.g. \"category date-\"): ";
+            std::string line;
+            std::getline(std::cin, line);
+
+            std::istringstream words(line);
+            std::string word;
+            while (words >> word) {
+                bool descending = word.back() == '-';
+                if (descending || word.back() == '+') word.pop_back();
+
+                if (word == "date" || word == "d")
+                    order.push_back({ SortField::DATE, descending });
+                else if (word == "amount" || word == "a")
+                    order.push_back({ SortField::AMOUNT, descending });
+                else if (word == "category" || word == "c")
+                    order.push_back({ SortField::CATEGORY, descending });
+                else {
+                    std::cout << "Unknown field '" << word << "'.\n";
+                    return;
+                }
+            }
+            if (order.empty()) {
+                std::cout << "No fields given.\n";
+                return;
+            }
         }
         else {
             std::cout << "Invalid option.\n";
+            return;
         }
+
+        applyOrder(order);
+        journalChange("S " + orderCode(order));
+
+        if (opt == 1)
+            std::cout << "Transactions sorted by date ascending.\n";
+        else if (opt == 2)
+            std::cout << "Transactions sorted by amount ascending.\n";
+        else if (opt == 3)
+            std::cout << "Transactions sorted by category.\n";
+        else if (opt == 4)
+            std::cout << "Transactions listed in order of entry.\n";
+        else
+            std::cout << "Transactions sorted.\n";
     }
 
     // Allows user to add a new budget or update an existing one.
@@ -421,27 +3175,27 @@ public:
             std::cout << "Category cannot be empty.\n";
             return;
         }
+        if (cat.find(',') != std::string::npos) {
+            std::cout << "Category cannot contain ','.\n";
+            return;
+        }
 
         std::cout << "Enter budget limit (positive number): ";
-        double limit = readDouble("");
+        Money limit = readMoney("");
 
         if (limit < 0) {
             std::cout << "Limit cannot be negative.\n";
             return;
         }
 
-        // Check if the budget already exists.
-        for (auto& b : budgets) {
-            if (b.getCategory() == cat) {
-                b.setLimit(limit);
-                std::cout << "Budget updated for category '" << cat << "'.\n";
-                return;
-            }
-        }
+        Budget b(categories.intern(cat), limit);
+        bool updated = applyBudget(b.getCategoryId(), limit);
+        journalChange(budgetRecord(b));
 
-        // Otherwise, add new category.
-        budgets.push_back(Budget(cat, limit));
-        std::cout << "Budget added for category '" << cat << "'.\n";
+        if (updated)
+            std::cout << "Budget updated for category '" << cat << "'.\n";
+        else
+            std::cout << "Budget added for category '" << cat << "'.\n";
     }
 
     // Lists all defined budgets.
@@ -457,8 +3211,7 @@ public:
         for (const auto& b : budgets) {
             std::cout << std::setw(18) << b.getCategory()
                 << " | $"
-                << std::fixed << std::setprecision(2)
-                << b.getLimit() << "\n";
+                << formatMoney(b.getLimit()) << "\n";
         }
     }
 
@@ -469,31 +3222,22 @@ public:
             return;
         }
 
-        // Map category → total spent.
-        std::map<std::string, double> spentPerCategory;
-
-        for (const auto& t : transactions) {
-            if (t.getAmount() < 0) {
-                spentPerCategory[t.getCategory()] += (-t.getAmount());
-            }
-        }
-
         bool anyExceeded = false;
         std::cout << "\nBudget check:\n";
 
         for (const auto& b : budgets) {
-            double spent = spentPerCategory[b.getCategory()];
+            Money spent = spentOn(b.getCategoryId());
 
             if (spent > b.getLimit()) {
                 std::cout << "ALERT! Category '" << b.getCategory()
                     << "' has exceeded the budget! Spent: $"
-                    << spent << ", Limit: $" << b.getLimit() << "\n";
+                    << formatMoney(spent) << ", Limit: $" << formatMoney(b.getLimit()) << "\n";
                 anyExceeded = true;
             }
             else {
                 std::cout << "Category '" << b.getCategory()
                     << "' is within budget. Spent: $"
-                    << spent << ", Limit: $" << b.getLimit() << "\n";
+                    << formatMoney(spent) << ", Limit: $" << formatMoney(b.getLimit()) << "\n";
             }
         }
 
@@ -525,30 +3269,85 @@ void printMenu() {
     std::cout << "9. Add or update budget\n";
     std::cout << "10. List budgets\n";
     std::cout << "11. Check budgets\n";
+    std::cout << "12. Save binary snapshot\n";
+    std::cout << "13. Load binary snapshot\n";
+    std::cout << "14. Delete transactions matching a filter\n";
     std::cout << "0. Exit\n";
     std::cout << "Select option: ";
 }
 
+// Asks for the conditions of a bulk operation; empty answers match anything.
+TransactionFilter inputFilter() {
+    TransactionFilter filter;
+    std::string line;
+
+    while (true) {
+        std::cout << "From date (YYYY-MM-DD, empty = any): ";
+        std::getline(std::cin, line);
+        if (trimView(line).empty() || validateDate(trimView(line), filter.fromDate)) break;
+        std::cout << "Invalid date, try again.\n";
+    }
+
+    while (true) {
+        std::cout << "To date (YYYY-MM-DD, empty = any): ";
+        std::getline(std::cin, line);
+        if (trimView(line).empty() || validateDate(trimView(line), filter.toDate)) break;
+        std::cout << "Invalid date, try again.\n";
+    }
+
+    std::cout << "Category (exact, empty = any): ";
+    std::getline(std::cin, line);
+    filter.category = trim(line);
+    filter.byCategory = !filter.category.empty();
+
+    while (true) {
+        std::cout << "Minimum amount (empty = any): ";
+        std::getline(std::cin, line);
+        if (trimView(line).empty() || parseMoney(line, filter.minAmount)) break;
+        std::cout << "Invalid amount, try again.\n";
+    }
+
+    while (true) {
+        std::cout << "Maximum amount (empty = any): ";
+        std::getline(std::cin, line);
+        if (trimView(line).empty() || parseMoney(line, filter.maxAmount)) break;
+        std::cout << "Invalid amount, try again.\n";
+    }
+
+    std::cout << "Description contains (empty = any): ";
+    std::getline(std::cin, filter.descriptionContains);
+
+    return filter;
+}
+
 // Collects all user inputs and creates a Transaction object.
 Transaction inputTransaction() {
-    std::string date, category, description;
-    double amount;
+    std::string dateStr, category, description;
+    std::uint32_t date;
+    Money amount;
 
     // Ask for date until format is valid.
     while (true) {
         std::cout << "Date (YYYY-MM-DD): ";
-        std::getline(std::cin, date);
+        std::getline(std::cin, dateStr);
 
-        if (validateDate(date))
+        if (validateDate(dateStr, date))
             break;
 
         std::cout << "Invalid date, try again.\n";
     }
 
-    // Ask for category.
-    std::cout << "Category: ";
-    std::getline(std::cin, category);
-    category = trim(category);
+    // Ask for category; a comma would split it in two in the CSV file.
+    while (true) {
+        std::cout << "Category: ";
+        std::getline(std::cin, category);
+        category = trim(category);
+
+        if (category.find(',') == std::string::npos)
+            break;
+
+        std::cout << "Category cannot contain ','. Try again.\n";
+    }
     if (category.empty()) category = "Miscellaneous";
 
     // Ask for amount.
@@ -557,10 +3356,8 @@ Transaction inputTransaction() {
         std::string amtStr;
         std::getline(std::cin, amtStr);
 
-        if (isNumber(amtStr)) {
-            amount = std::stod(amtStr);
+        if (parseMoney(amtStr, amount))
             break;
-        }
 
         std::cout << "Invalid amount, try again.\n";
     }
@@ -569,7 +3366,7 @@ Transaction inputTransaction() {
     std::cout << "Description: ";
     std::getline(std::cin, description);
 
-    return Transaction(date, category, amount, description);
+    return Transaction(date, categories.intern(category), amount, description);
 }
 
 // Main program loop.
@@ -577,6 +3374,10 @@ int main() {
     FinanceManager fm;
     bool running = true;
 
+    // Restore the default ledger (the CSV file or the snapshot, whichever
+    // was used last), including changes made after its last save.
+    fm.openLedger("data.csv", "data.pfm");
+
     while (running) {
         printMenu();
 
@@ -591,38 +3392,32 @@ int main() {
         case 1: {
             Transaction t = inputTransaction();
             fm.addTransaction(t);
-            pause();
+            pauseScreen();
             break;
         }
 
         case 2: {
             if (fm.isEmpty()) {
                 std::cout << "No transactions to delete.\n";
-                pause();
+                pauseScreen();
                 break;
             }
 
             fm.listTransactions();
 
-            // Correctly calculate max index.
-            int max_index = static_cast<int>(fm.getSize()) - 1;
+            std::uint64_t id = readId("Enter transaction ID to delete: ");
 
-            std::string prompt = "Enter transaction index to delete (0 to " +
-                std::to_string(max_index) + "): ";
-
-            int idx = readInt(prompt, 0, max_index);
-
-            if (!fm.deleteTransaction(idx)) {
-                std::cout << "Invalid index.\n";
+            if (!fm.deleteTransaction(id)) {
+                std::cout << "Invalid ID.\n";
             }
 
-            pause();
+            pauseScreen();
             break;
         }
 
         case 3:
             fm.listTransactions();
-            pause();
+            pauseScreen();
             break;
 
         case 4: {
@@ -632,8 +3427,9 @@ int main() {
 
             if (filename.empty()) filename = "data.csv";
 
-            fm.saveToFile(filename);
-            pause();
+            bool syncDirectory = readYes("Also sync the folder, so the save survives a power loss? (y/N): ");
+            fm.saveToFile(filename, syncDirectory);
+            pauseScreen();
             break;
         }
 
@@ -645,7 +3441,7 @@ int main() {
             if (filename.empty()) filename = "data.csv";
 
             fm.loadFromFile(filename);
-            pause();
+            pauseScreen();
             break;
         }
 
@@ -655,34 +3451,72 @@ int main() {
             std::getline(std::cin, ym);
 
             fm.monthlySummary(ym);
-            pause();
+            pauseScreen();
             break;
         }
 
         case 7:
             fm.searchTransactions();
-            pause();
+            pauseScreen();
             break;
 
         case 8:
             fm.sortTransactions();
-            pause();
+            pauseScreen();
             break;
 
         case 9:
             fm.addOrUpdateBudget();
-            pause();
+            pauseScreen();
             break;
 
         case 10:
             fm.listBudgets();
-            pause();
+            pauseScreen();
             break;
 
         case 11:
             fm.checkBudgets();
-            pause();
+            pauseScreen();
+            break;
+
+        case 12: {
+            std::cout << "Enter snapshot filename to save (e.g. data.pfm): ";
+            std::string filename;
+            std::getline(std::cin, filename);
+
+            if (filename.empty()) filename = "data.pfm";
+
+            bool syncDirectory = readYes("Also sync the folder, so the save survives a power loss? (y/N): ");
+            fm.saveSnapshot(filename, syncDirectory);
+            pauseScreen();
             break;
+        }
+
+        case 13: {
+            std::cout << "Enter snapshot filename to load (e.g. data.pfm): ";
+            std::string filename;
+            std::getline(std::cin, filename);
+
+            if (filename.empty()) filename = "data.pfm";
+
+            fm.loadSnapshot(filename);
+            pauseScreen();
+            break;
+        }
+
+        case 14: {
+            if (fm.isEmpty()) {
+                std::cout << "No transactions to delete.\n";
+                pauseScreen();
+                break;
+            }
+
+            TransactionFilter filter = inputFilter();
+            fm.deleteMatching(filter);
+            pauseScreen();
+            break;
+        }
 
         case 0:
             running = false;
@@ -691,7 +3525,7 @@ int main() {
 
         default:
             std::cout << "Invalid option, please try again.\n";
-            pause();
+            pauseScreen();
             break;
         }
     }